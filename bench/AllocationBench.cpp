@@ -0,0 +1,109 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts the heap allocations made by the system updates once their reused
+// buffers have grown, which should be none.
+static std::atomic<unsigned long> allocationCount {0};
+
+void *operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { std::free(pointer); }
+
+// Walks its entities like MovementSystem did before views
+class BenchMovementSystem : public System {
+    public:
+        BenchMovementSystem() {
+            RequireComponent<BenchTransform, BenchRigidBody>();
+        }
+
+        void Update(double deltaTime) {
+            for (auto entity : GetSystemEntities()) {
+                auto &transform = entity.GetMutableComponent<BenchTransform>();
+                const auto &rigidBody = entity.GetComponent<const BenchRigidBody>();
+                transform.position += rigidBody.velocity * static_cast<float>(deltaTime);
+            }
+        }
+};
+
+// Gathers and sorts its entities into reused buffers like RenderSystem
+class BenchRenderSystem : public System {
+    private:
+        std::vector<const BenchTransform *> renderables;
+
+    public:
+        BenchRenderSystem() {
+            RequireComponent<BenchTransform, BenchAnimation>();
+        }
+
+        void Update() {
+            renderables.clear();
+            world->View<const BenchTransform, const BenchAnimation>().Each([this](const BenchTransform &transform, const BenchAnimation &) {
+                renderables.push_back(&transform);
+            });
+            std::sort(renderables.begin(), renderables.end(), [](const BenchTransform *a, const BenchTransform *b) {
+                return a->position.y < b->position.y;
+            });
+        }
+};
+
+// Advances the animations in parallel like AnimationSystem
+class BenchAnimationSystem : public System {
+    public:
+        BenchAnimationSystem() {
+            RequireComponent<BenchAnimation>();
+        }
+
+        void Update(JobSystem &jobSystem) {
+            world->View<BenchAnimation>().ParallelEach(jobSystem, [](BenchAnimation &animation) {
+                animation.currentFrame = (animation.currentFrame + 1) % animation.numFrames;
+            });
+        }
+};
+
+int main() {
+    SilenceLogger();
+
+    std::printf("AllocationBench: heap allocations after the first frame\n");
+    for (unsigned int workerCount : {0u, 3u}) {
+        for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+            JobSystem jobSystem(workerCount);
+            World world(storageMode);
+            world.AddSystem<BenchMovementSystem>();
+            world.AddSystem<BenchRenderSystem>();
+            world.AddSystem<BenchAnimationSystem>();
+            world.CreateEntities(500, BenchTransform(), BenchRigidBody());
+            world.CreateEntities(500, BenchTransform(), BenchRigidBody(), BenchAnimation());
+
+            const auto frame = [&]() {
+                world.Update();
+                world.GetSystem<BenchMovementSystem>().Update(0.016);
+                world.GetSystem<BenchAnimationSystem>().Update(jobSystem);
+                world.GetSystem<BenchRenderSystem>().Update();
+            };
+
+            frame();
+            SilenceLogger();
+
+            const unsigned int frameCount = 100;
+            const auto firstCount = allocationCount.load();
+            for (unsigned int i = 0; i < frameCount; i++) {
+                frame();
+            }
+            const auto count = allocationCount.load() - firstCount;
+
+            std::printf("%-10s %u workers, 1000 entities, 3 systems   %lu allocations in %u frames\n", storageMode == STORAGE_POOLS ? "pools" : "archetypes", workerCount, count, frameCount);
+        }
+    }
+    return 0;
+}
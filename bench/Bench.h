@@ -0,0 +1,58 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "../src/ECS/ECS.h"
+#include "../src/Logger/Logger.h"
+
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark Helpers
+////////////////////////////////////////////////////////////////////////////////
+// Shared by the benchmarks in bench/, built and run by `make bench`. The
+// benchmarks only link the engine sources that don't need SDL, so they use
+// components shaped like the game's instead of including Components.h.
+// Results are printed to stdout, the log output is silenced.
+////////////////////////////////////////////////////////////////////////////////
+struct BenchTransform {
+    glm::vec2 position = glm::vec2(0, 0);
+    glm::vec2 scale = glm::vec2(1, 1);
+    double rotation = 0.0;
+};
+
+struct BenchRigidBody {
+    glm::vec2 velocity = glm::vec2(1, 1);
+};
+
+struct BenchAnimation {
+    int numFrames = 4;
+    int currentFrame = 1;
+    int frameSpeedRate = 10;
+    bool isLoop = true;
+    int startTime = 0;
+};
+
+// Drops the log lines, both printed and kept in memory
+inline void SilenceLogger() {
+    std::cout.rdbuf(nullptr);
+    Logger::entries.clear();
+    Logger::entries.shrink_to_fit();
+}
+
+// Average duration of func in milliseconds, after a warm-up run
+template <typename TFunc>
+double MeasureMilliseconds(unsigned int runCount, TFunc func) {
+    func();
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < runCount; i++) {
+        func();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    Logger::entries.clear();
+    return std::chrono::duration<double, std::milli>(end - start).count() / runCount;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include "Bench.h"
+
+#include <thread>
+
+// Scaling of an embarrassingly parallel MovementSystem-style update with
+// the number of job system threads. The update walks the transform pool in
+// chunks of 4096 entities and looks the rigid bodies up by entity id.
+int main() {
+    SilenceLogger();
+
+    const unsigned int entityCount = 1000000;
+    World world;
+    world.CreateEntities(entityCount, BenchTransform(), BenchRigidBody());
+    world.Update();
+    SilenceLogger();
+
+    auto transforms = world.GetComponentPool<BenchTransform>();
+    auto rigidBodies = world.GetComponentPool<const BenchRigidBody>();
+    const auto &entityIds = transforms->GetEntityIds();
+
+    std::printf("JobBench: 1M entity movement update, average of 50 frames, %u hardware threads\n", std::thread::hardware_concurrency());
+
+    double singleThreadMilliseconds = 0;
+    for (unsigned int threadCount : {1u, 2u, 4u, 8u}) {
+        JobSystem jobSystem(threadCount - 1);
+        const auto milliseconds = MeasureMilliseconds(50, [&]() {
+            jobSystem.ParallelFor(entityCount, 4096, [&](unsigned int begin, unsigned int end) {
+                for (unsigned int i = begin; i < end; i++) {
+                    (*transforms)[i].position += rigidBodies->Get(entityIds[i]).velocity * 0.016f;
+                }
+            });
+        });
+        if (threadCount == 1) {
+            singleThreadMilliseconds = milliseconds;
+        }
+
+        std::printf("%u threads   %7.3f ms   speedup %.2fx\n", threadCount, milliseconds, singleThreadMilliseconds / milliseconds);
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "Bench.h"
+
+// Save and restore of a 100k entity world, the target being a restore under
+// 5 ms. Half of the entities also have an animation, and three systems have
+// to be refilled on restore.
+class BenchMovementSystem : public System {
+    public:
+        BenchMovementSystem() {
+            RequireComponent<BenchTransform, BenchRigidBody>();
+        }
+};
+
+class BenchRenderSystem : public System {
+    public:
+        BenchRenderSystem() {
+            RequireComponent<BenchTransform>();
+        }
+};
+
+class BenchAnimationSystem : public System {
+    public:
+        BenchAnimationSystem() {
+            RequireComponent<BenchAnimation>();
+        }
+};
+
+int main() {
+    SilenceLogger();
+
+    const unsigned int entityCount = 100000;
+    std::printf("SnapshotBench: %u entities, average of 20 runs\n", entityCount);
+
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        World world(storageMode);
+        world.AddSystem<BenchMovementSystem>();
+        world.AddSystem<BenchRenderSystem>();
+        world.AddSystem<BenchAnimationSystem>();
+        world.CreateEntities(entityCount / 2, BenchTransform(), BenchRigidBody(), BenchAnimation());
+        world.CreateEntities(entityCount / 2, BenchTransform(), BenchRigidBody());
+        world.Update();
+        SilenceLogger();
+
+        std::vector<unsigned char> buffer;
+        const auto saveMilliseconds = MeasureMilliseconds(20, [&]() { world.SaveSnapshot(buffer); });
+        const auto restoreMilliseconds = MeasureMilliseconds(20, [&]() {
+            if (!world.RestoreSnapshot(buffer)) {
+                std::printf("Restore failed\n");
+            }
+        });
+
+        std::printf("%-10s   %8zu bytes   save %7.3f ms   restore %7.3f ms\n", storageMode == STORAGE_POOLS ? "pools" : "archetypes", buffer.size(), saveMilliseconds, restoreMilliseconds);
+    }
+    return 0;
+}
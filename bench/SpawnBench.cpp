@@ -0,0 +1,29 @@
+#include "Bench.h"
+
+// Spawning 200k entities with CreateEntities in batches of various sizes. The
+// storage grows geometrically, so small batches should cost about the same
+// per entity as large ones.
+static double MeasureSpawn(StorageMode storageMode, unsigned int entityCount, unsigned int batchSize) {
+    return MeasureMilliseconds(5, [&]() {
+        World world(storageMode);
+        for (unsigned int created = 0; created < entityCount; created += batchSize) {
+            world.CreateEntities(batchSize, BenchTransform(), BenchRigidBody());
+        }
+        world.Update();
+    });
+}
+
+int main() {
+    SilenceLogger();
+
+    const unsigned int entityCount = 200000;
+    std::printf("SpawnBench: %u entities created in batches, average of 5 runs\n", entityCount);
+
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        for (unsigned int batchSize : {10u, 100u, 10000u}) {
+            const auto milliseconds = MeasureSpawn(storageMode, entityCount, batchSize);
+            std::printf("%-10s   batches of %5u   %8.3f ms\n", storageMode == STORAGE_POOLS ? "pools" : "archetypes", batchSize, milliseconds);
+        }
+    }
+    return 0;
+}
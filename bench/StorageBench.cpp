@@ -0,0 +1,52 @@
+#include "Bench.h"
+
+// Pools against archetypes on a MovementSystem-style update, which moves
+// every entity with a transform and a rigid body by its velocity. A third of
+// the entities also have an animation, so archetype mode has two archetypes.
+class BenchMovementSystem : public System {
+    public:
+        BenchMovementSystem() {
+            RequireComponent<BenchTransform, BenchRigidBody>();
+        }
+};
+
+static void RunStorageBench(unsigned int entityCount) {
+    double milliseconds[3] = {};
+
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        World world(storageMode);
+        world.AddSystem<BenchMovementSystem>();
+        world.CreateEntities(entityCount - entityCount / 3, BenchTransform(), BenchRigidBody());
+        world.CreateEntities(entityCount / 3, BenchTransform(), BenchRigidBody(), BenchAnimation());
+        world.Update();
+        SilenceLogger();
+
+        if (storageMode == STORAGE_POOLS) {
+            // Each entity of the system looked up in both pools
+            milliseconds[0] = MeasureMilliseconds(20, [&]() {
+                for (auto entity : world.GetSystem<BenchMovementSystem>().GetSystemEntities()) {
+                    auto &transform = entity.GetMutableComponent<BenchTransform>();
+                    const auto &rigidBody = entity.GetComponent<const BenchRigidBody>();
+                    transform.position += rigidBody.velocity * 0.016f;
+                }
+            });
+        }
+
+        milliseconds[storageMode == STORAGE_POOLS ? 1 : 2] = MeasureMilliseconds(20, [&]() {
+            world.View<BenchTransform, const BenchRigidBody>().Each([](BenchTransform &transform, const BenchRigidBody &rigidBody) {
+                transform.position += rigidBody.velocity * 0.016f;
+            });
+        });
+    }
+
+    std::printf("%8u entities   pools + GetComponent %8.3f ms   pools + view %8.3f ms   archetypes + view %8.3f ms\n", entityCount, milliseconds[0], milliseconds[1], milliseconds[2]);
+}
+
+int main() {
+    SilenceLogger();
+    std::printf("StorageBench: movement update per frame, average of 20 frames\n");
+    for (unsigned int entityCount : {10000u, 100000u, 1000000u}) {
+        RunStorageBench(entityCount);
+    }
+    return 0;
+}
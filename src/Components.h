@@ -1,6 +1,8 @@
 #ifndef COMPONENTS_H
 #define COMPONENTS_H
 
+#include "ECS/ECS.h"
+
 #include <string>
 #include <glm/glm.hpp>
 
@@ -69,4 +71,67 @@ struct BoxColliderComponent {
     }
 };
 
+// Attaches an entity to a parent. The TransformComponent of the entity is then
+// computed by the TransformSystem from the parent's transform and the local
+// transform below, so it must not be changed directly.
+struct HierarchyComponent {
+    Entity parent;
+    glm::vec2 localPosition;
+    glm::vec2 localScale;
+    double localRotation;
+
+    HierarchyComponent(Entity parent = Entity(), glm::vec2 localPosition = glm::vec2(0, 0), glm::vec2 localScale = glm::vec2(1, 1), double localRotation = 0.0) {
+        this->parent = parent;
+        this->localPosition = localPosition;
+        this->localScale = localScale;
+        this->localRotation = localRotation;
+    }
+};
+
+// Snapshot serializers of the components that can't be copied as raw bytes
+template <>
+struct ComponentSerializer<SpriteComponent> {
+    static void Write(SnapshotWriter &writer, const SpriteComponent &sprite) {
+        writer.WriteString(sprite.assetId);
+        writer.Write(sprite.width);
+        writer.Write(sprite.height);
+        writer.Write(sprite.zIndex);
+        writer.Write(sprite.srcRect);
+    }
+
+    static bool Read(SnapshotReader &reader, SpriteComponent &sprite) {
+        return reader.ReadString(sprite.assetId) && reader.Read(sprite.width) && reader.Read(sprite.height) && reader.Read(sprite.zIndex) && reader.Read(sprite.srcRect);
+    }
+};
+
+// The parent handle is rebound to the world being restored
+template <>
+struct ComponentSerializer<HierarchyComponent> {
+    static void Write(SnapshotWriter &writer, const HierarchyComponent &hierarchy) {
+        writer.Write(hierarchy.parent.GetId());
+        writer.Write(hierarchy.localPosition);
+        writer.Write(hierarchy.localScale);
+        writer.Write(hierarchy.localRotation);
+    }
+
+    static bool Read(SnapshotReader &reader, HierarchyComponent &hierarchy) {
+        unsigned int parentId;
+        if (!reader.Read(parentId)) {
+            return false;
+        }
+        hierarchy.parent = Entity(parentId, reader.GetWorld());
+        return reader.Read(hierarchy.localPosition) && reader.Read(hierarchy.localScale) && reader.Read(hierarchy.localRotation);
+    }
+};
+
+// Give the engine components compile-time ids, in this order, in every run
+REGISTER_COMPONENTS(
+    TransformComponent,
+    RigidBodyComponent,
+    SpriteComponent,
+    AnimationComponent,
+    BoxColliderComponent,
+    HierarchyComponent
+);
+
 #endif
\ No newline at end of file
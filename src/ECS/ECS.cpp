@@ -2,8 +2,22 @@
 #include "../Logger/Logger.h"
 
 #include <algorithm>
+#include <cstdlib>
 
-unsigned int IComponent::nextId = 0;
+std::atomic<unsigned int> IComponent::nextId {0};
+std::atomic<unsigned int> ISingleton::nextId {0};
+
+unsigned int IComponent::CreateRuntimeId(unsigned int registeredCount) {
+    // Types can be first used from several jobs at once
+    const auto runtimeIndex = nextId++;
+    if (runtimeIndex + registeredCount >= MAX_COMPONENTS) {
+        // The id would collide with a registered one or fall outside of the
+        // signatures, nothing sensible can be done with it
+        Logger::Error("Error: Too many component types, increase SIGNATURE_BITS.");
+        std::abort();
+    }
+    return MAX_COMPONENTS - 1 - runtimeIndex;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // Entity
@@ -16,102 +30,1519 @@ void Entity::Destroy() {
     world->DestroyEntity(*this);
 }
 
+bool Entity::IsAlive() const {
+    return world->IsAlive(*this);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // System
 ////////////////////////////////////////////////////////////////////////////////
+thread_local const System *System::runningSystem = nullptr;
+
 void System::AddEntityToSystem(Entity entity) {
-    entities.push_back(entity);
+    const auto entityIndex = entity.GetIndex();
+    if (HasEntity(entity)) {
+        return;
+    }
+
+    if (entityIndex >= entityIdToIndex.size()) {
+        entityIdToIndex.resize(entityIndex + 1, INVALID_INDEX);
+    }
+
+    entityIdToIndex[entityIndex] = entityIds.size();
+    entityIds.push_back(entity.GetId());
+    membershipVersion++;
+
+    // The world sorts the entity on its optional components once it joined
+    AddEntityToOptionalPartitions(entity.GetId(), Signature());
 }
 
 void System::RemoveEntityFromSystem(Entity entity) {
-    entities.erase(
-        std::remove_if(
-            entities.begin(),
-            entities.end(),
-            [&entity](Entity other) {
-                return entity == other;
-            }
-        ),
-        entities.end()
-    );
+    const auto entityIndex = entity.GetIndex();
+    if (!HasEntity(entity)) {
+        return;
+    }
+
+    const auto index = entityIdToIndex[entityIndex];
+    const auto lastIndex = entityIds.size() - 1;
+
+    if (index != lastIndex) {
+        entityIds[index] = entityIds[lastIndex];
+        entityIdToIndex[GetEntityIndex(entityIds[index])] = index;
+    }
+
+    entityIds.pop_back();
+    entityIdToIndex[entityIndex] = INVALID_INDEX;
+    membershipVersion++;
+
+    RemoveEntityFromOptionalPartitions(entityIndex);
+}
+
+void System::OptionalPartition::Swap(unsigned int index, unsigned int otherIndex) {
+    std::swap(entityIds[index], entityIds[otherIndex]);
+    entityIdToIndex[GetEntityIndex(entityIds[index])] = index;
+    entityIdToIndex[GetEntityIndex(entityIds[otherIndex])] = otherIndex;
+}
+
+void System::OptionalPartition::Clear() {
+    withCount = 0;
+    entityIds.clear();
+    entityIdToIndex.clear();
+}
+
+void System::AddEntityToOptionalPartitions(unsigned int entityId, const Signature &entitySignature) {
+    const auto entityIndex = GetEntityIndex(entityId);
+    for (auto &partition : optionalPartitions) {
+        if (entityIndex >= partition.entityIdToIndex.size()) {
+            partition.entityIdToIndex.resize(entityIndex + 1, INVALID_INDEX);
+        }
+
+        // Appended to the entities lacking the component, then moved to the
+        // boundary if it has it
+        const unsigned int index = partition.entityIds.size();
+        partition.entityIdToIndex[entityIndex] = index;
+        partition.entityIds.push_back(entityId);
+        if (entitySignature.test(partition.componentId)) {
+            partition.Swap(index, partition.withCount++);
+        }
+    }
 }
 
-std::vector<Entity> System::GetSystemEntities() const {
-    return entities;
+void System::RemoveEntityFromOptionalPartitions(unsigned int entityIndex) {
+    for (auto &partition : optionalPartitions) {
+        auto index = partition.entityIdToIndex[entityIndex];
+        if (index < partition.withCount) {
+            partition.Swap(index, --partition.withCount);
+            index = partition.withCount;
+        }
+        partition.Swap(index, partition.entityIds.size() - 1);
+        partition.entityIds.pop_back();
+        partition.entityIdToIndex[entityIndex] = INVALID_INDEX;
+    }
+}
+
+void System::UpdateOptionalComponents(Entity entity, const Signature &entitySignature) {
+    if (optionalPartitions.empty() || !HasEntity(entity)) {
+        return;
+    }
+
+    for (auto &partition : optionalPartitions) {
+        const auto index = partition.entityIdToIndex[entity.GetIndex()];
+        const bool hasComponent = entitySignature.test(partition.componentId);
+        if (hasComponent && index >= partition.withCount) {
+            partition.Swap(index, partition.withCount++);
+            membershipVersion++;
+        } else if (!hasComponent && index < partition.withCount) {
+            partition.Swap(index, --partition.withCount);
+            membershipVersion++;
+        }
+    }
+}
+
+EntityRange System::GetOptionalEntities(unsigned int componentId, bool hasComponent) const {
+    for (const auto &partition : optionalPartitions) {
+        if (partition.componentId == componentId) {
+            const auto *entityIds = partition.entityIds.data();
+            return hasComponent
+                ? EntityRange(entityIds, entityIds + partition.withCount, world)
+                : EntityRange(entityIds + partition.withCount, entityIds + partition.entityIds.size(), world);
+        }
+    }
+
+    assert(false && "The component isn't an optional component of the system");
+    return EntityRange(nullptr, nullptr, world);
+}
+
+bool System::HasEntity(Entity entity) const {
+    const auto entityIndex = entity.GetIndex();
+    return entityIndex < entityIdToIndex.size() && entityIdToIndex[entityIndex] != INVALID_INDEX && entityIds[entityIdToIndex[entityIndex]] == entity.GetId();
+}
+
+bool System::IsInterested(const Signature &entitySignature) const {
+    return entitySignature.Contains(componentSignature) && !entitySignature.Intersects(excludedSignature);
+}
+
+EntityRange System::GetSystemEntities() const {
+    return EntityRange(entityIds.data(), entityIds.data() + entityIds.size(), world);
+}
+
+const std::vector<unsigned int> &System::GetSystemEntityIds() const {
+    return entityIds;
 }
 
 const Signature &System::GetComponentSignature() const {
     return componentSignature;
 }
 
+unsigned int System::GetMembershipVersion() const {
+    return membershipVersion;
+}
+
+bool System::CanWrite(unsigned int componentId) const {
+    return !HasDeclaredAccess() || writeSignature.test(componentId);
+}
+
+bool System::HasDeclaredAccess() const {
+    return readSignature.any() || writeSignature.any();
+}
+
+bool System::ConflictsWith(const System &other) const {
+    if (!HasDeclaredAccess() || !other.HasDeclaredAccess()) {
+        return true;
+    }
+
+    // Concurrent reads are fine, a write conflicts with any other access.
+    // Optional components are read.
+    const auto reads = readSignature | optionalSignature;
+    const auto otherReads = other.readSignature | other.optionalSignature;
+    return writeSignature.Intersects(otherReads | other.writeSignature) || other.writeSignature.Intersects(reads);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Archetype
+////////////////////////////////////////////////////////////////////////////////
+static std::size_t AlignOffset(std::size_t offset, std::size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+Archetype::Archetype(const Signature &signature, const std::vector<ComponentInfo> &componentInfos) : signature(signature) {
+    std::size_t rowSize = sizeof(unsigned int);
+
+    for (unsigned int componentId = 0; componentId < componentInfos.size(); componentId++) {
+        if (!signature.test(componentId) || componentInfos[componentId].isTag) {
+            continue;
+        }
+
+        if (componentId >= columnIndices.size()) {
+            columnIndices.resize(componentId + 1, -1);
+        }
+        columnIndices[componentId] = columns.size();
+
+        Column column;
+        column.componentId = componentId;
+        column.info = componentInfos[componentId];
+        column.offset = 0;
+        column.ticksOffset = 0;
+        columns.push_back(column);
+
+        rowSize += column.info.size + sizeof(ComponentTicks);
+    }
+
+    // Fit as many rows as possible in a chunk, taking the padding between the
+    // columns into account. Very large components get a chunk of their own.
+    chunkCapacity = std::max<std::size_t>(ARCHETYPE_CHUNK_SIZE / rowSize, 1);
+    while (true) {
+        std::size_t offset = chunkCapacity * sizeof(unsigned int);
+        for (auto &column : columns) {
+            offset = AlignOffset(offset, column.info.alignment);
+            column.offset = offset;
+            offset += chunkCapacity * column.info.size;
+
+            offset = AlignOffset(offset, alignof(ComponentTicks));
+            column.ticksOffset = offset;
+            offset += chunkCapacity * sizeof(ComponentTicks);
+        }
+        chunkBytes = AlignOffset(offset, ARCHETYPE_CHUNK_ALIGNMENT);
+
+        if (chunkBytes <= ARCHETYPE_CHUNK_SIZE || chunkCapacity == 1) {
+            break;
+        }
+        chunkCapacity--;
+    }
+}
+
+Archetype::Archetype(const Archetype &other)
+    : signature(other.signature), columns(other.columns), columnIndices(other.columnIndices),
+      chunkCapacity(other.chunkCapacity), chunkBytes(other.chunkBytes) {
+    // Same layout, so the rows are copied a chunk column at a time
+    Reserve(other.size);
+    for (unsigned int chunk = 0; chunk < other.GetChunkCount(); chunk++) {
+        const auto rowCount = other.GetChunkSize(chunk);
+        std::memcpy(GetEntityIds(chunk), other.GetEntityIds(chunk), rowCount * sizeof(unsigned int));
+
+        for (const auto &column : columns) {
+            column.info.copyConstruct(chunks[chunk] + column.offset, other.chunks[chunk] + column.offset, rowCount);
+            std::memcpy(chunks[chunk] + column.ticksOffset, other.chunks[chunk] + column.ticksOffset, rowCount * sizeof(ComponentTicks));
+        }
+    }
+    size = other.size;
+}
+
+Archetype::~Archetype() {
+    Clear();
+    for (auto chunk : chunks) {
+        ::operator delete(chunk, std::align_val_t(ARCHETYPE_CHUNK_ALIGNMENT));
+    }
+}
+
+unsigned char *Archetype::GetAddress(unsigned int row, const Column &column) const {
+    return chunks[row / chunkCapacity] + column.offset + (row % chunkCapacity) * column.info.size;
+}
+
+ComponentTicks *Archetype::GetTicksAddress(unsigned int row, const Column &column) const {
+    return reinterpret_cast<ComponentTicks *>(chunks[row / chunkCapacity] + column.ticksOffset) + row % chunkCapacity;
+}
+
+unsigned int Archetype::GetChunkSize(unsigned int chunk) const {
+    return std::min(size - chunk * chunkCapacity, chunkCapacity);
+}
+
+unsigned int Archetype::AddRow(unsigned int entityId) {
+    const auto row = size++;
+
+    if (row / chunkCapacity >= chunks.size()) {
+        chunks.push_back(static_cast<unsigned char *>(::operator new(chunkBytes, std::align_val_t(ARCHETYPE_CHUNK_ALIGNMENT))));
+    }
+
+    GetEntityIds(row / chunkCapacity)[row % chunkCapacity] = entityId;
+
+    return row;
+}
+
+unsigned int Archetype::RemoveRow(unsigned int row) {
+    const auto lastRow = size - 1;
+    unsigned int movedEntityId = INVALID_INDEX;
+
+    for (const auto &column : columns) {
+        column.info.destroy(GetAddress(row, column), 1);
+    }
+
+    if (row != lastRow) {
+        for (const auto &column : columns) {
+            column.info.moveConstruct(GetAddress(row, column), GetAddress(lastRow, column));
+            column.info.destroy(GetAddress(lastRow, column), 1);
+            *GetTicksAddress(row, column) = *GetTicksAddress(lastRow, column);
+        }
+
+        movedEntityId = GetEntityIds(lastRow / chunkCapacity)[lastRow % chunkCapacity];
+        GetEntityIds(row / chunkCapacity)[row % chunkCapacity] = movedEntityId;
+    }
+
+    size--;
+
+    return movedEntityId;
+}
+
+void Archetype::Reserve(unsigned int rowCount) {
+    const auto chunkCount = (rowCount + chunkCapacity - 1) / chunkCapacity;
+    chunks.reserve(chunkCount);
+    while (chunks.size() < chunkCount) {
+        chunks.push_back(static_cast<unsigned char *>(::operator new(chunkBytes, std::align_val_t(ARCHETYPE_CHUNK_ALIGNMENT))));
+    }
+}
+
+void Archetype::Compact() {
+    while (chunks.size() > GetChunkCount()) {
+        ::operator delete(chunks.back(), std::align_val_t(ARCHETYPE_CHUNK_ALIGNMENT));
+        chunks.pop_back();
+    }
+    chunks.shrink_to_fit();
+}
+
+void Archetype::Clear() {
+    for (unsigned int chunk = 0; chunk < GetChunkCount(); chunk++) {
+        for (const auto &column : columns) {
+            column.info.destroy(chunks[chunk] + column.offset, GetChunkSize(chunk));
+        }
+    }
+    size = 0;
+}
+
+void Archetype::MoveRow(unsigned int row, Archetype &other, unsigned int otherRow) {
+    for (const auto &column : columns) {
+        if (other.HasColumn(column.componentId)) {
+            const auto &otherColumn = other.columns[other.columnIndices[column.componentId]];
+            column.info.moveConstruct(other.GetAddress(otherRow, otherColumn), GetAddress(row, column));
+            *other.GetTicksAddress(otherRow, otherColumn) = *GetTicksAddress(row, column);
+        }
+    }
+}
+
+void *Archetype::GetComponent(unsigned int row, unsigned int componentId) const {
+    return GetAddress(row, columns[columnIndices[componentId]]);
+}
+
+ComponentTicks &Archetype::GetTicks(unsigned int row, unsigned int componentId) const {
+    return *GetTicksAddress(row, columns[columnIndices[componentId]]);
+}
+
+ComponentTicks *Archetype::GetTicksColumn(unsigned int chunk, unsigned int componentId) const {
+    return reinterpret_cast<ComponentTicks *>(chunks[chunk] + columns[columnIndices[componentId]].ticksOffset);
+}
+
+unsigned int *Archetype::GetEntityIds(unsigned int chunk) const {
+    return reinterpret_cast<unsigned int *>(chunks[chunk]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Command Buffer
+////////////////////////////////////////////////////////////////////////////////
+CommandBuffer::~CommandBuffer() {
+    Clear();
+    for (auto &block : blocks) {
+        ::operator delete(block.data, std::align_val_t(ARCHETYPE_CHUNK_ALIGNMENT));
+    }
+}
+
+void *CommandBuffer::Allocate(std::size_t size, std::size_t alignment) {
+    // Move on to the next block when the current one is full, components
+    // larger than a block get a block of their own
+    while (true) {
+        if (blockIndex == blocks.size()) {
+            const auto blockSize = std::max(size, COMMAND_BLOCK_SIZE);
+            blocks.push_back({static_cast<unsigned char *>(::operator new(blockSize, std::align_val_t(ARCHETYPE_CHUNK_ALIGNMENT))), blockSize});
+        }
+
+        const auto offset = AlignOffset(blockOffset, alignment);
+        if (offset + size <= blocks[blockIndex].size) {
+            blockOffset = offset + size;
+            return blocks[blockIndex].data + offset;
+        }
+
+        blockIndex++;
+        blockOffset = 0;
+    }
+}
+
+DeferredEntity CommandBuffer::CreateEntity(unsigned int sortKey) {
+    DeferredEntity entity;
+    entity.index = deferredEntityCount++;
+    entity.sortKey = sortKey;
+
+    Command command;
+    command.type = COMMAND_CREATE_ENTITY;
+    command.sortKey = sortKey;
+    command.entityId = entity.index;
+    command.isDeferred = true;
+    command.component = nullptr;
+    command.play = nullptr;
+    command.destroy = nullptr;
+    commands.push_back(command);
+
+    return entity;
+}
+
+void CommandBuffer::DestroyEntity(unsigned int sortKey, Entity entity) {
+    Command command;
+    command.type = COMMAND_DESTROY_ENTITY;
+    command.sortKey = sortKey;
+    command.entityId = entity.GetId();
+    command.isDeferred = false;
+    command.component = nullptr;
+    command.play = nullptr;
+    command.destroy = nullptr;
+    commands.push_back(command);
+}
+
+void CommandBuffer::Clear() {
+    // Destroy the components that weren't handed to the world
+    for (auto &command : commands) {
+        if (command.component) {
+            command.destroy(command.component);
+        }
+    }
+
+    commands.clear();
+    createdEntities.clear();
+    deferredEntityCount = 0;
+    blockIndex = 0;
+    blockOffset = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Snapshot
+////////////////////////////////////////////////////////////////////////////////
+void SnapshotWriter::WriteBytes(const void *data, std::size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    const auto offset = buffer.size();
+    GrowVector(buffer, offset + size);
+    buffer.resize(offset + size);
+    std::memcpy(buffer.data() + offset, data, size);
+}
+
+void SnapshotWriter::WriteString(const std::string &string) {
+    Write<unsigned int>(string.size());
+    WriteBytes(string.data(), string.size());
+}
+
+bool SnapshotReader::ReadBytes(void *data, std::size_t size) {
+    if (size > GetRemainingSize()) {
+        current = end;
+        return false;
+    }
+
+    if (size > 0) {
+        std::memcpy(data, current, size);
+        current += size;
+    }
+    return true;
+}
+
+bool SnapshotReader::ReadString(std::string &string) {
+    unsigned int size;
+    if (!Read(size) || size > GetRemainingSize()) {
+        return false;
+    }
+
+    string.assign(reinterpret_cast<const char *>(current), size);
+    current += size;
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // World
 ////////////////////////////////////////////////////////////////////////////////
-Entity World::CreateEntity() {
+Entity World::AllocateEntity() {
     unsigned int entityId;
 
-    if (freeIds.empty()) {
-        entityId = numEntities++;
-        if (entityId >= entityComponentSignatures.size()) {
-            entityComponentSignatures.resize(entityId + 1);
+    if (nextFreeIndex == MAX_ENTITIES) {
+        const unsigned int entityIndex = entityIds.size();
+        if (entityIndex >= MAX_ENTITIES) {
+            Logger::Error("Error: Could not create entity, the maximum number of entities was reached.");
+            return Entity(INVALID_ENTITY_ID, this);
+        }
+
+        if (entityIndex >= entityCapacity) {
+            ReserveEntities(GrowCapacity(entityCapacity, entityIndex + 1));
+        }
+
+        entityId = CreateEntityId(entityIndex, 0);
+        entityIds.push_back(entityId);
+
+        entityComponentSignatures.resize(entityIndex + 1);
+        entityMatchedSignatures.resize(entityIndex + 1);
+        entityPendingFlags.resize(entityIndex + 1);
+        if (storageMode == STORAGE_ARCHETYPES) {
+            entityLocations.resize(entityIndex + 1);
         }
     } else {
-        entityId = freeIds.front();
-        freeIds.pop_front();
+        // Pop the first free slot, its generation was already bumped when it
+        // was freed
+        const auto entityIndex = nextFreeIndex;
+        const auto freeSlot = entityIds[entityIndex];
+
+        nextFreeIndex = GetEntityIndex(freeSlot);
+        entityId = CreateEntityId(entityIndex, GetEntityGeneration(freeSlot));
+        entityIds[entityIndex] = entityId;
     }
 
-    Entity entity(entityId);
-    entity.world = this;
-    entitiesToBeCreated.insert(entity);
+    Entity entity(entityId, this);
+    entitiesToBeCreated.push_back(entityId);
+    entityPendingFlags[GetEntityIndex(entityId)] = PENDING_CREATE;
 
-    Logger::Log("Entity created with id = " + std::to_string(entityId));
+    return entity;
+}
+
+Entity World::CreateEntity() {
+    const auto entity = AllocateEntity();
+
+    Logger::Log("Entity created with id = " + std::to_string(entity.GetId()));
 
     return entity;
 }
 
 void World::DestroyEntity(Entity entity) {
-    entitiesToBeDestroyed.insert(entity);
+    if (!IsAlive(entity) || (entityPendingFlags[entity.GetIndex()] & PENDING_DESTROY)) {
+        return;
+    }
+
+    entitiesToBeDestroyed.push_back(entity.GetId());
+    entityPendingFlags[entity.GetIndex()] |= PENDING_DESTROY;
     Logger::Log("Entity destroyed with id = " + std::to_string(entity.GetId()));
 }
 
+void World::ReserveEntities(unsigned int count) {
+    if (count <= entityCapacity) {
+        return;
+    }
+    entityCapacity = count;
+
+    entityIds.reserve(count);
+    entityComponentSignatures.reserve(count);
+    entityMatchedSignatures.reserve(count);
+    entityPendingFlags.reserve(count);
+    if (storageMode == STORAGE_ARCHETYPES) {
+        entityLocations.reserve(count);
+    }
+
+    // Shared pools are sized when they're copied on the first write
+    for (auto &pool : componentPools) {
+        if (pool && pool.use_count() == 1) {
+            pool->ReserveEntities(count);
+        }
+    }
+}
+
+void World::Compact() {
+    // Entity slots can't be released since free slots keep their generation
+    entityIds.shrink_to_fit();
+    entityComponentSignatures.shrink_to_fit();
+    entityMatchedSignatures.shrink_to_fit();
+    entityPendingFlags.shrink_to_fit();
+    entityLocations.shrink_to_fit();
+    entityCapacity = entityIds.size();
+
+    entitiesToBeCreated.shrink_to_fit();
+    entitiesToBeDestroyed.shrink_to_fit();
+    entitiesToBeRematched.shrink_to_fit();
+
+    // Shared pools aren't worth copying just to compact them
+    for (auto &pool : componentPools) {
+        if (pool && pool.use_count() == 1) {
+            pool->Compact();
+        }
+    }
+    for (auto &archetype : archetypes) {
+        archetype->Compact();
+    }
+    for (auto &system : systems) {
+        system.second->entityIds.shrink_to_fit();
+        system.second->entityIdToIndex.shrink_to_fit();
+        for (auto &partition : system.second->optionalPartitions) {
+            partition.entityIds.shrink_to_fit();
+            partition.entityIdToIndex.shrink_to_fit();
+        }
+    }
+
+    // The cache is rebuilt lazily with the signatures still in use
+    systemsBySignature.clear();
+
+    Logger::Log("World compacted");
+}
+
 void World::AddEntityToSystems(Entity entity) {
-    const auto entityId = entity.GetId();
+    const auto entityIndex = entity.GetIndex();
 
     // Match entityComponentSignature <---> systemComponentSignature
-    const auto &entityComponentSignature = entityComponentSignatures[entityId];
+    const auto &entityComponentSignature = entityComponentSignatures[entityIndex];
 
-    for (auto &system : systems) {
-        const auto &systemComponentSignature = system.second->GetComponentSignature();
+    for (auto system : GetInterestedSystems(entityComponentSignature)) {
+        system->AddEntityToSystem(entity);
+        system->UpdateOptionalComponents(entity, entityComponentSignature);
+    }
+
+    entityMatchedSignatures[entityIndex] = entityComponentSignature;
+}
+
+void World::RemoveEntityFromSystems(Entity entity) {
+    // Only the systems that matched the entity signature can contain it
+    auto &entityMatchedSignature = entityMatchedSignatures[entity.GetIndex()];
+
+    for (auto system : GetInterestedSystems(entityMatchedSignature)) {
+        system->RemoveEntityFromSystem(entity);
+    }
 
-        bool isInterested = (entityComponentSignature & systemComponentSignature) == systemComponentSignature;
+    entityMatchedSignature.reset();
+}
+
+void World::RematchEntityWithSystems(Entity entity) {
+    const auto entityIndex = entity.GetIndex();
+    const auto &oldSignature = entityMatchedSignatures[entityIndex];
+    const auto &newSignature = entityComponentSignatures[entityIndex];
+
+    if (oldSignature == newSignature) {
+        return;
+    }
 
-        if (isInterested) {
-            system.second->AddEntityToSystem(entity);
+    for (auto system : GetInterestedSystems(oldSignature)) {
+        if (!system->IsInterested(newSignature)) {
+            system->RemoveEntityFromSystem(entity);
         }
     }
+
+    // Systems the entity stays in only need their optional components updated
+    for (auto system : GetInterestedSystems(newSignature)) {
+        if (!system->IsInterested(oldSignature)) {
+            system->AddEntityToSystem(entity);
+            system->UpdateOptionalComponents(entity, newSignature);
+        } else if ((oldSignature & system->optionalSignature) != (newSignature & system->optionalSignature)) {
+            system->UpdateOptionalComponents(entity, newSignature);
+        }
+    }
+
+    entityMatchedSignatures[entityIndex] = newSignature;
 }
 
-void World::RemoveEntityFromSystems(Entity entity) {
+void World::MarkEntityToBeRematched(Entity entity) {
+    // Entities waiting to be created are matched with their final signature
+    // anyway, so they don't need to be rematched
+    auto &pendingFlags = entityPendingFlags[entity.GetIndex()];
+    if (pendingFlags & (PENDING_CREATE | PENDING_REMATCH)) {
+        return;
+    }
+
+    pendingFlags |= PENDING_REMATCH;
+    entitiesToBeRematched.push_back(entity.GetId());
+}
+
+const std::vector<System *> &World::GetInterestedSystems(const Signature &signature) {
+    auto interestedSystems = systemsBySignature.find(signature);
+    if (interestedSystems != systemsBySignature.end()) {
+        return interestedSystems->second;
+    }
+
+    auto &newInterestedSystems = systemsBySignature[signature];
     for (auto &system : systems) {
-        system.second->RemoveEntityFromSystem(entity);
+        if (system.second->IsInterested(signature)) {
+            newInterestedSystems.push_back(system.second.get());
+        }
+    }
+
+    return newInterestedSystems;
+}
+
+void World::RunScheduledSystems(JobSystem &jobSystem) {
+    const unsigned int scheduledCount = scheduledSystems.size();
+    if (scheduledCount == 0) {
+        return;
+    }
+
+    if (scheduledCount > scheduledDependencyCapacity) {
+        scheduledDependencyCapacity = GrowCapacity(scheduledDependencyCapacity, scheduledCount);
+        scheduledDependencyCounts.reset(new std::atomic<unsigned int>[scheduledDependencyCapacity]);
+    }
+    // Build the dependency graph: each system waits for the earlier scheduled
+    // systems it conflicts with, which keeps conflicting systems in order
+    scheduledDependents.clear();
+    for (auto &scheduledSystem : scheduledSystems) {
+        scheduledSystem.dependencyCount = 0;
+    }
+    for (unsigned int i = 0; i < scheduledCount; i++) {
+        auto &scheduledSystem = scheduledSystems[i];
+        scheduledSystem.firstDependent = scheduledDependents.size();
+
+        for (unsigned int j = i + 1; j < scheduledCount; j++) {
+            if (scheduledSystem.system->ConflictsWith(*scheduledSystems[j].system)) {
+                scheduledDependents.push_back(j);
+                scheduledSystems[j].dependencyCount++;
+            }
+        }
+
+        scheduledSystem.dependentCount = scheduledDependents.size() - scheduledSystem.firstDependent;
+        scheduledDependencyCounts[i].store(scheduledSystem.dependencyCount, std::memory_order_relaxed);
+    }
+
+    // Copy the written pools that are shared with a clone before the jobs
+    // start, so that the jobs of a system never race to copy a pool
+    for (unsigned int componentId = 0; componentId < componentPools.size(); componentId++) {
+        const bool isWritten = std::any_of(scheduledSystems.begin(), scheduledSystems.end(), [componentId](const ScheduledSystem &scheduledSystem) {
+            return scheduledSystem.system->CanWrite(componentId);
+        });
+        if (isWritten) {
+            GetWritablePool(componentId);
+        }
+    }
+
+    // Start the systems that don't wait for anything, the others are started
+    // by the last system they wait for. The live counts can already be zero
+    // for systems started by a finished one, so the initial counts are used.
+    ReserveCommandBuffers(jobSystem.GetThreadCount());
+    scheduleJobSystem = &jobSystem;
+    for (unsigned int i = 0; i < scheduledCount; i++) {
+        if (scheduledSystems[i].dependencyCount == 0) {
+            jobSystem.Run([this, i]() { RunScheduledSystem(i); }, &scheduleCounter);
+        }
+    }
+    jobSystem.Wait(scheduleCounter);
+
+    scheduleJobSystem = nullptr;
+    scheduledSystems.clear();
+}
+
+void World::RunScheduledSystem(unsigned int index) {
+    auto &scheduledSystem = scheduledSystems[index];
+    System::RunAs(scheduledSystem.system, [&scheduledSystem]() { scheduledSystem.update(*scheduledSystem.system); });
+
+    for (unsigned int i = 0; i < scheduledSystem.dependentCount; i++) {
+        const auto dependent = scheduledDependents[scheduledSystem.firstDependent + i];
+        if (scheduledDependencyCounts[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            scheduleJobSystem->Run([this, dependent]() { RunScheduledSystem(dependent); }, &scheduleCounter);
+        }
+    }
+}
+
+void World::ReserveCommandBuffers(unsigned int threadCount) {
+    while (commandBuffers.size() < threadCount) {
+        commandBuffers.push_back(std::make_unique<CommandBuffer>());
+    }
+}
+
+CommandBuffer &World::GetCommandBuffer() {
+    const auto threadIndex = JobSystem::GetCurrentThreadIndex();
+    if (threadIndex >= commandBuffers.size()) {
+        Logger::Error("Error: No command buffer was reserved for thread " + std::to_string(threadIndex) + ".");
+        return *commandBuffers[0];
+    }
+    return *commandBuffers[threadIndex];
+}
+
+void World::PlayCommandBuffers() {
+    playbackCommands.clear();
+    for (unsigned int bufferIndex = 0; bufferIndex < commandBuffers.size(); bufferIndex++) {
+        const auto &commands = commandBuffers[bufferIndex]->commands;
+        for (unsigned int commandIndex = 0; commandIndex < commands.size(); commandIndex++) {
+            playbackCommands.push_back({commands[commandIndex].sortKey, bufferIndex, commandIndex});
+        }
+    }
+    if (playbackCommands.empty()) {
+        return;
+    }
+
+    // Commands sharing a key keep the order they were recorded in
+    std::sort(playbackCommands.begin(), playbackCommands.end(), [](const PlaybackCommand &a, const PlaybackCommand &b) {
+        if (a.sortKey != b.sortKey) {
+            return a.sortKey < b.sortKey;
+        }
+        if (a.bufferIndex != b.bufferIndex) {
+            return a.bufferIndex < b.bufferIndex;
+        }
+        return a.commandIndex < b.commandIndex;
+    });
+
+    for (const auto &playbackCommand : playbackCommands) {
+        auto &buffer = *commandBuffers[playbackCommand.bufferIndex];
+        auto &command = buffer.commands[playbackCommand.commandIndex];
+
+        if (command.type == COMMAND_CREATE_ENTITY) {
+            buffer.createdEntities.resize(buffer.deferredEntityCount);
+            buffer.createdEntities[command.entityId] = CreateEntity();
+            continue;
+        }
+
+        // Entities created by the buffer are created by commands with the
+        // same key recorded before, so they already exist
+        const auto entity = command.isDeferred ? buffer.createdEntities[command.entityId] : Entity(command.entityId, this);
+        if (!IsAlive(entity)) {
+            continue;
+        }
+
+        if (command.type == COMMAND_DESTROY_ENTITY) {
+            DestroyEntity(entity);
+        } else {
+            command.play(*this, entity, command.component);
+            if (command.component) {
+                command.destroy(command.component);
+                command.component = nullptr;
+            }
+        }
+    }
+
+    for (auto &buffer : commandBuffers) {
+        buffer->Clear();
     }
 }
 
 void World::Update() {
+    // Everything that happens until the next update is stamped with the new tick
+    currentTick++;
+
+    // Apply the structural changes recorded by the jobs since the last update
+    PlayCommandBuffers();
+
     // Add the entities that are waiting to be created to the active Systems
+    // Update the systems of the entities that gained or lost components
     // Remove the entities that are waiting to be created to the active Systems
 
-    for (auto entity : entitiesToBeCreated) {
-        AddEntityToSystems(entity);
+    for (auto entityId : entitiesToBeCreated) {
+        const auto entityIndex = GetEntityIndex(entityId);
+        entityPendingFlags[entityIndex] &= ~PENDING_CREATE;
+        RecordComponentEvent(COMPONENT_ADDED, entityId, entityComponentSignatures[entityIndex]);
+        AddEntityToSystems(Entity(entityId, this));
     }
     entitiesToBeCreated.clear();
 
-    for (auto entity : entitiesToBeDestroyed) {
+    // The components gained and lost are the difference with the signature
+    // the entity was last matched with
+    for (auto entityId : entitiesToBeRematched) {
+        const auto entityIndex = GetEntityIndex(entityId);
+        const auto &oldSignature = entityMatchedSignatures[entityIndex];
+        const auto &newSignature = entityComponentSignatures[entityIndex];
+        entityPendingFlags[entityIndex] &= ~PENDING_REMATCH;
+        RecordComponentEvent(COMPONENT_ADDED, entityId, newSignature & ~oldSignature);
+        RecordComponentEvent(COMPONENT_REMOVED, entityId, oldSignature & ~newSignature);
+        RematchEntityWithSystems(Entity(entityId, this));
+    }
+    entitiesToBeRematched.clear();
+
+    DispatchComponentEvent(COMPONENT_ADDED);
+    DispatchComponentEvent(COMPONENT_REMOVED);
+
+    // Observers of destroyed entities can destroy more of them, which are
+    // reported in another batch
+    unsigned int observedDestroyCount = 0;
+    while (observedDestroyCount < entitiesToBeDestroyed.size()) {
+        for (; observedDestroyCount < entitiesToBeDestroyed.size(); observedDestroyCount++) {
+            const auto entityId = entitiesToBeDestroyed[observedDestroyCount];
+            RecordComponentEvent(COMPONENT_DESTROYED, entityId, entityMatchedSignatures[GetEntityIndex(entityId)]);
+        }
+        DispatchComponentEvent(COMPONENT_DESTROYED);
+    }
+
+    for (auto entityId : entitiesToBeDestroyed) {
+        const Entity entity(entityId, this);
+        const auto entityIndex = entity.GetIndex();
+
         RemoveEntityFromSystems(entity);
-        entityComponentSignatures[entity.GetId()].reset();
 
-        // Make the entity id available to be reused
-        freeIds.push_back(entity.GetId());
+        // Release the components owned by the entity
+        if (storageMode == STORAGE_ARCHETYPES) {
+            RemoveEntityFromArchetype(entity.GetId());
+        } else {
+            const auto &signature = entityComponentSignatures[entityIndex];
+            for (unsigned int componentId = 0; componentId < componentPools.size(); componentId++) {
+                if (signature.test(componentId) && componentPools[componentId]) {
+                    UpdateEntityGroup(entity.GetId(), componentId, Signature());
+                    GetWritablePool(componentId)->RemoveEntityFromPool(entity.GetId());
+                }
+            }
+        }
+
+        entityComponentSignatures[entityIndex].reset();
+        entityPendingFlags[entityIndex] = 0;
+
+        // Push the slot on the free list, bumping its generation so that the
+        // destroyed entity is no longer alive. A slot that used its last
+        // generation is retired, so the generation never wraps around.
+        if (entity.GetGeneration() == ENTITY_GENERATION_MASK) {
+            entityIds[entityIndex] = INVALID_ENTITY_ID;
+            continue;
+        }
+        entityIds[entityIndex] = CreateEntityId(nextFreeIndex, entity.GetGeneration() + 1);
+        nextFreeIndex = entityIndex;
+    }
+    entitiesToBeDestroyed.clear();
+}
+
+void World::AddObserver(ComponentEvent event, unsigned int componentId, std::function<void(EntityRange)> callback) {
+    auto &observers = componentObservers[event];
+    if (componentId >= observers.size()) {
+        observers.resize(componentId + 1);
+    }
+    observers[componentId].callbacks.push_back(std::move(callback));
+    observedSignatures[event].set(componentId);
+}
+
+void World::RecordComponentEvent(ComponentEvent event, unsigned int entityId, const Signature &signature) {
+    const auto observedSignature = signature & observedSignatures[event];
+    if (observedSignature.none()) {
+        return;
+    }
+
+    auto &observers = componentObservers[event];
+    for (unsigned int componentId = 0; componentId < observers.size(); componentId++) {
+        if (observedSignature.test(componentId)) {
+            observers[componentId].entityIds.push_back(entityId);
+        }
+    }
+}
+
+void World::DispatchComponentEvent(ComponentEvent event) {
+    for (auto &observers : componentObservers[event]) {
+        if (observers.entityIds.empty()) {
+            continue;
+        }
+
+        const EntityRange entities(observers.entityIds.data(), observers.entityIds.data() + observers.entityIds.size(), this);
+        for (auto &callback : observers.callbacks) {
+            callback(entities);
+        }
+        observers.entityIds.clear();
+    }
+}
+
+void World::CreateGroup(const Signature &signature) {
+    if (FindGroup(signature) != INVALID_GROUP) {
+        return;
+    }
+
+    std::vector<unsigned int> componentIds;
+    for (unsigned int componentId = 0; componentId < componentPools.size(); componentId++) {
+        if (!signature.test(componentId)) {
+            continue;
+        }
+        if (componentId < componentGroups.size() && componentGroups[componentId] != INVALID_GROUP) {
+            Logger::Error("Component id = " + std::to_string(componentId) + " is already owned by another group");
+            return;
+        }
+        componentIds.push_back(componentId);
+    }
+
+    const unsigned int groupIndex = groups.size();
+    componentGroups.resize(componentPools.size(), INVALID_GROUP);
+    for (auto componentId : componentIds) {
+        componentGroups[componentId] = groupIndex;
+    }
+    groups.push_back({signature, componentIds, 0});
+
+    // Pack the entities that already have all the components of the group
+    for (unsigned int entityIndex = 0; entityIndex < entityIds.size(); entityIndex++) {
+        if (entityComponentSignatures[entityIndex].Contains(signature)) {
+            UpdateEntityGroup(entityIds[entityIndex], componentIds.front(), signature);
+        }
+    }
+
+    Logger::Log("Group created with " + std::to_string(groups.back().size) + " entities");
+}
+
+unsigned int World::FindGroup(const Signature &signature) const {
+    for (unsigned int groupIndex = 0; groupIndex < groups.size(); groupIndex++) {
+        if (groups[groupIndex].signature == signature) {
+            return groupIndex;
+        }
+    }
+    return INVALID_GROUP;
+}
+
+void World::UpdateEntityGroup(unsigned int entityId, unsigned int componentId, const Signature &signature) {
+    if (componentId >= componentGroups.size() || componentGroups[componentId] == INVALID_GROUP) {
+        return;
+    }
+
+    auto &group = groups[componentGroups[componentId]];
+    const bool isMember = componentPools[componentId]->GetIndex(entityId) < group.size;
+    if (isMember == signature.Contains(group.signature)) {
+        return;
+    }
+
+    // Members join at the end of the packed range and leave by swapping with
+    // its last member, the range stays aligned across the owned pools
+    if (isMember) {
+        group.size--;
+    }
+    for (auto groupComponentId : group.componentIds) {
+        auto pool = GetWritablePool(groupComponentId);
+        pool->Swap(pool->GetIndex(entityId), group.size);
+    }
+    if (!isMember) {
+        group.size++;
+    }
+}
+
+unsigned int World::GetOrCreateArchetype(const Signature &signature) {
+    auto archetype = archetypeIndices.find(signature);
+    if (archetype != archetypeIndices.end()) {
+        return archetype->second;
+    }
+
+    archetypeIndices.emplace(signature, archetypes.size());
+    archetypes.push_back(std::make_unique<Archetype>(signature, componentInfos));
+
+    return archetypes.size() - 1;
+}
+
+void World::MoveEntityToArchetype(unsigned int entityId, const Signature &signature) {
+    auto &location = entityLocations[GetEntityIndex(entityId)];
+
+    unsigned int newArchetype = Archetype::INVALID_INDEX;
+    unsigned int newRow = Archetype::INVALID_INDEX;
+
+    if (signature.any()) {
+        newArchetype = GetOrCreateArchetype(signature);
+        newRow = archetypes[newArchetype]->AddRow(entityId);
+
+        if (location.archetype != Archetype::INVALID_INDEX) {
+            archetypes[location.archetype]->MoveRow(location.row, *archetypes[newArchetype], newRow);
+        }
     }
+
+    RemoveEntityFromArchetype(entityId);
+
+    location.archetype = newArchetype;
+    location.row = newRow;
+}
+
+void World::RemoveEntityFromArchetype(unsigned int entityId) {
+    auto &location = entityLocations[GetEntityIndex(entityId)];
+    if (location.archetype == Archetype::INVALID_INDEX) {
+        return;
+    }
+
+    // The last entity of the archetype is moved into the freed row
+    const auto movedEntityId = archetypes[location.archetype]->RemoveRow(location.row);
+    if (movedEntityId != Archetype::INVALID_INDEX) {
+        entityLocations[GetEntityIndex(movedEntityId)].row = location.row;
+    }
+
+    location.archetype = Archetype::INVALID_INDEX;
+    location.row = Archetype::INVALID_INDEX;
+}
+
+void *World::GetComponentAddress(unsigned int entityId, unsigned int componentId) const {
+    const auto &location = entityLocations[GetEntityIndex(entityId)];
+    return archetypes[location.archetype]->GetComponent(location.row, componentId);
+}
+
+ComponentTicks &World::GetComponentTicks(unsigned int entityId, unsigned int componentId) const {
+    if (storageMode == STORAGE_ARCHETYPES) {
+        const auto &location = entityLocations[GetEntityIndex(entityId)];
+        return archetypes[location.archetype]->GetTicks(location.row, componentId);
+    }
+    return GetWritablePool(componentId)->GetTicks(entityId);
+}
+
+IPool *World::GetWritablePool(unsigned int componentId) const {
+    auto &pool = componentPools[componentId];
+    if (pool && pool.use_count() > 1) {
+        pool = pool->Clone();
+    }
+    return pool.get();
+}
+
+void World::ClearEntities() {
+    for (auto &system : systems) {
+        system.second->entityIds.clear();
+        system.second->entityIdToIndex.clear();
+        system.second->membershipVersion++;
+        for (auto &partition : system.second->optionalPartitions) {
+            partition.Clear();
+        }
+    }
+    // Pools shared with clones are replaced rather than copied and cleared
+    for (auto &pool : componentPools) {
+        if (pool && pool.use_count() > 1) {
+            pool = pool->CreateEmpty();
+        } else if (pool) {
+            pool->Clear();
+        }
+    }
+    for (auto &group : groups) {
+        group.size = 0;
+    }
+    for (auto &buffer : commandBuffers) {
+        buffer->Clear();
+    }
+
+    // The archetypes keep their chunks, so that restoring a snapshot into
+    // the world doesn't allocate them again
+    for (auto &archetype : archetypes) {
+        archetype->Clear();
+    }
+
+    entityIds.clear();
+    entityComponentSignatures.clear();
+    entityMatchedSignatures.clear();
+    entityPendingFlags.clear();
+    entityLocations.clear();
+    entitiesToBeCreated.clear();
     entitiesToBeDestroyed.clear();
-}
\ No newline at end of file
+    entitiesToBeRematched.clear();
+    nextFreeIndex = MAX_ENTITIES;
+}
+
+bool World::SaveSnapshot(std::vector<unsigned char> &buffer) const {
+    // Only the component types some entity has are saved, and all of them
+    // need to be serializable
+    Signature usedSignature;
+    for (const auto &signature : entityComponentSignatures) {
+        usedSignature |= signature;
+    }
+
+    std::vector<unsigned int> componentIds;
+    for (unsigned int componentId = 0; componentId < componentInfos.size(); componentId++) {
+        const auto &info = componentInfos[componentId];
+        if (!usedSignature.test(componentId) || info.isTag) {
+            continue;
+        }
+        if (!info.isSerializable) {
+            Logger::Error("Component id = " + std::to_string(componentId) + " can't be saved, it needs a ComponentSerializer");
+            return false;
+        }
+        componentIds.push_back(componentId);
+    }
+
+    buffer.clear();
+    SnapshotWriter writer(buffer);
+
+    writer.Write(SNAPSHOT_MAGIC);
+    writer.Write(SNAPSHOT_VERSION);
+    writer.Write<unsigned int>(sizeof(Signature));
+    writer.Write(GetTick());
+    writer.Write(nextFreeIndex);
+
+    writer.WriteVector(entityIds);
+    writer.WriteVector(entityComponentSignatures);
+    writer.WriteVector(entityMatchedSignatures);
+    writer.WriteVector(entityPendingFlags);
+    writer.WriteVector(entitiesToBeCreated);
+    writer.WriteVector(entitiesToBeDestroyed);
+    writer.WriteVector(entitiesToBeRematched);
+
+    // Each component type is written as the ids of the entities having it,
+    // followed by the components in the same order
+    writer.Write<unsigned int>(componentIds.size());
+    for (auto componentId : componentIds) {
+        writer.Write(componentId);
+
+        if (storageMode == STORAGE_POOLS) {
+            componentPools[componentId]->Save(writer);
+            continue;
+        }
+
+        unsigned int count = 0;
+        for (const auto &archetype : archetypes) {
+            if (archetype->HasColumn(componentId)) {
+                count += archetype->GetSize();
+            }
+        }
+
+        writer.Write(count);
+        for (const auto &archetype : archetypes) {
+            if (!archetype->HasColumn(componentId)) {
+                continue;
+            }
+            for (unsigned int chunk = 0; chunk < archetype->GetChunkCount(); chunk++) {
+                writer.WriteBytes(archetype->GetEntityIds(chunk), archetype->GetChunkSize(chunk) * sizeof(unsigned int));
+            }
+        }
+        for (const auto &archetype : archetypes) {
+            if (!archetype->HasColumn(componentId)) {
+                continue;
+            }
+            for (unsigned int chunk = 0; chunk < archetype->GetChunkCount(); chunk++) {
+                const auto firstRow = chunk * archetype->GetChunkCapacity();
+                componentInfos[componentId].write(writer, archetype->GetComponent(firstRow, componentId), archetype->GetChunkSize(chunk));
+            }
+        }
+    }
+
+    Logger::Log("Snapshot saved with " + std::to_string(entityIds.size()) + " entities in " + std::to_string(buffer.size()) + " bytes");
+    return true;
+}
+
+bool World::RestoreSnapshot(const std::vector<unsigned char> &buffer) {
+    SnapshotReader reader(buffer.data(), buffer.size(), this);
+
+    // The header is checked before anything is cleared
+    unsigned int magic, version, signatureSize;
+    if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(signatureSize) || magic != SNAPSHOT_MAGIC) {
+        Logger::Error("Error: Not a world snapshot.");
+        return false;
+    }
+    if (version != SNAPSHOT_VERSION || signatureSize != sizeof(Signature)) {
+        Logger::Error("Error: Snapshot version " + std::to_string(version) + " with " + std::to_string(signatureSize * 8) + " signature bits isn't supported.");
+        return false;
+    }
+
+    ClearEntities();
+    if (!ReadSnapshot(reader)) {
+        Logger::Error("Error: Snapshot is corrupted or doesn't match the world.");
+        ClearEntities();
+        return false;
+    }
+
+    Logger::Log("Snapshot restored with " + std::to_string(entityIds.size()) + " entities");
+    return true;
+}
+
+bool World::ReadSnapshot(SnapshotReader &reader) {
+    unsigned int tick;
+    if (!reader.Read(tick) || !reader.Read(nextFreeIndex)) {
+        return false;
+    }
+
+    const bool isRead =
+        reader.ReadVector(entityIds) &&
+        reader.ReadVector(entityComponentSignatures) &&
+        reader.ReadVector(entityMatchedSignatures) &&
+        reader.ReadVector(entityPendingFlags) &&
+        reader.ReadVector(entitiesToBeCreated) &&
+        reader.ReadVector(entitiesToBeDestroyed) &&
+        reader.ReadVector(entitiesToBeRematched);
+    if (!isRead) {
+        return false;
+    }
+
+    const unsigned int entityCount = entityIds.size();
+    if (entityComponentSignatures.size() != entityCount || entityMatchedSignatures.size() != entityCount || entityPendingFlags.size() != entityCount) {
+        return false;
+    }
+    // Free slots hold the index of the next free slot, the list must only
+    // link free slots and end within entityCount steps
+    unsigned int freeIndex = nextFreeIndex;
+    for (unsigned int step = 0; freeIndex != MAX_ENTITIES; step++) {
+        if (freeIndex >= entityCount || step >= entityCount || GetEntityIndex(entityIds[freeIndex]) == freeIndex) {
+            return false;
+        }
+        freeIndex = GetEntityIndex(entityIds[freeIndex]);
+    }
+    for (const auto *pendingEntities : {&entitiesToBeCreated, &entitiesToBeDestroyed, &entitiesToBeRematched}) {
+        for (auto entityId : *pendingEntities) {
+            if (GetEntityIndex(entityId) >= entityCount) {
+                return false;
+            }
+        }
+    }
+
+    // Number of live entities having each component type. Entities created
+    // together share their signature, so the counts are added once per run.
+    std::array<unsigned int, MAX_COMPONENTS> componentEntityCounts {};
+    for (unsigned int entityIndex = 0; entityIndex < entityCount;) {
+        const auto &signature = entityComponentSignatures[entityIndex];
+        unsigned int runLength = 0;
+        for (; entityIndex < entityCount && entityComponentSignatures[entityIndex] == signature; entityIndex++) {
+            if (GetEntityIndex(entityIds[entityIndex]) == entityIndex) {
+                runLength++;
+            }
+        }
+        for (unsigned int componentId = 0; componentId < MAX_COMPONENTS; componentId++) {
+            if (signature.test(componentId)) {
+                componentEntityCounts[componentId] += runLength;
+            }
+        }
+    }
+
+    // The component types of the snapshot must be known to this world
+    Signature usedSignature;
+    for (unsigned int componentId = 0; componentId < MAX_COMPONENTS; componentId++) {
+        if (componentEntityCounts[componentId] > 0) {
+            usedSignature.set(componentId);
+        }
+    }
+    for (unsigned int componentId = 0; componentId < MAX_COMPONENTS; componentId++) {
+        if (!usedSignature.test(componentId)) {
+            continue;
+        }
+        const bool isRegistered = componentId < componentInfos.size() && componentInfos[componentId].size > 0;
+        const bool hasStorage = isRegistered && (componentInfos[componentId].isTag || storageMode == STORAGE_ARCHETYPES || componentPools[componentId]);
+        if (!hasStorage) {
+            Logger::Error("Component id = " + std::to_string(componentId) + " isn't registered in this world");
+            return false;
+        }
+    }
+
+    // Restored components are stamped with a tick newer than any change seen
+    // so far, so consumers of changes pick all of them up
+    currentTick = std::max(GetTick(), tick) + 1;
+    const auto restoreTick = GetTick();
+    for (auto &changedTick : componentChangedTicks) {
+        changedTick.store(restoreTick, std::memory_order_relaxed);
+    }
+
+    entityCapacity = std::max(entityCapacity, entityCount);
+    for (auto &pool : componentPools) {
+        if (pool) {
+            pool->ReserveEntities(entityCapacity);
+        }
+    }
+
+    // Archetype rows are created up front with default components, so that
+    // every row holds constructed components even if a read fails. Components
+    // read as raw bytes have nothing to destroy, they're left as is. Entities
+    // sharing their signature also share the archetype lookup.
+    if (storageMode == STORAGE_ARCHETYPES) {
+        entityLocations.assign(entityCount, EntityLocation());
+        unsigned int archetypeIndex = Archetype::INVALID_INDEX;
+        for (unsigned int entityIndex = 0; entityIndex < entityCount; entityIndex++) {
+            const auto &signature = entityComponentSignatures[entityIndex];
+            if (GetEntityIndex(entityIds[entityIndex]) != entityIndex || signature.none()) {
+                continue;
+            }
+
+            if (archetypeIndex == Archetype::INVALID_INDEX || archetypes[archetypeIndex]->GetSignature() != signature) {
+                archetypeIndex = GetOrCreateArchetype(signature);
+            }
+            auto &location = entityLocations[entityIndex];
+            location.archetype = archetypeIndex;
+            location.row = archetypes[archetypeIndex]->AddRow(entityIds[entityIndex]);
+        }
+
+        for (const auto &archetype : archetypes) {
+            for (unsigned int componentId = 0; componentId < componentInfos.size(); componentId++) {
+                if (!archetype->HasColumn(componentId)) {
+                    continue;
+                }
+
+                const auto &info = componentInfos[componentId];
+                for (unsigned int chunk = 0; chunk < archetype->GetChunkCount(); chunk++) {
+                    const auto rowCount = archetype->GetChunkSize(chunk);
+                    if (!info.isReadAsBytes) {
+                        info.defaultConstruct(archetype->GetComponent(chunk * archetype->GetChunkCapacity(), componentId), rowCount);
+                    }
+                    std::fill_n(archetype->GetTicksColumn(chunk, componentId), rowCount, ComponentTicks{restoreTick, restoreTick});
+                }
+            }
+        }
+    }
+
+    unsigned int componentCount;
+    if (!reader.Read(componentCount)) {
+        return false;
+    }
+    // Each component type must list exactly the live entities whose
+    // signature has it: no unknown or dead entity, no entity twice and none
+    // missing. Duplicates are caught by the pools, or by the rows read here.
+    Signature readSignature;
+    std::vector<unsigned int> componentEntityIds;
+    std::vector<unsigned int> lastReadComponentIds;
+    for (unsigned int i = 0; i < componentCount; i++) {
+        unsigned int componentId;
+        if (!reader.Read(componentId) || componentId >= MAX_COMPONENTS || !usedSignature.test(componentId) || componentInfos[componentId].isTag || readSignature.test(componentId)) {
+            return false;
+        }
+        readSignature.set(componentId);
+
+        const auto hasComponent = [this, entityCount, componentId](unsigned int entityId) {
+            const auto entityIndex = GetEntityIndex(entityId);
+            return entityIndex < entityCount && entityIds[entityIndex] == entityId && entityComponentSignatures[entityIndex].test(componentId);
+        };
+
+        if (storageMode == STORAGE_POOLS) {
+            const auto &pool = componentPools[componentId];
+            if (!pool->Load(reader, restoreTick) || pool->GetEntityIds().size() != componentEntityCounts[componentId]) {
+                return false;
+            }
+            if (!std::all_of(pool->GetEntityIds().begin(), pool->GetEntityIds().end(), hasComponent)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (!reader.ReadVector(componentEntityIds) || componentEntityIds.size() != componentEntityCounts[componentId]) {
+            return false;
+        }
+        if (lastReadComponentIds.empty()) {
+            lastReadComponentIds.assign(entityCount, MAX_COMPONENTS);
+        }
+
+        // Entities that follow each other in the same chunk are read at once
+        for (unsigned int i = 0; i < componentEntityIds.size();) {
+            if (!hasComponent(componentEntityIds[i])) {
+                return false;
+            }
+            auto &lastReadComponentId = lastReadComponentIds[GetEntityIndex(componentEntityIds[i])];
+            if (lastReadComponentId == componentId) {
+                return false;
+            }
+            lastReadComponentId = componentId;
+
+            const auto &location = entityLocations[GetEntityIndex(componentEntityIds[i])];
+            const auto &archetype = *archetypes[location.archetype];
+            const auto chunkEnd = (location.row / archetype.GetChunkCapacity() + 1) * archetype.GetChunkCapacity();
+
+            unsigned int rowCount = 1;
+            while (i + rowCount < componentEntityIds.size() && location.row + rowCount < chunkEnd && hasComponent(componentEntityIds[i + rowCount])) {
+                const auto &nextLocation = entityLocations[GetEntityIndex(componentEntityIds[i + rowCount])];
+                auto &nextLastReadComponentId = lastReadComponentIds[GetEntityIndex(componentEntityIds[i + rowCount])];
+                if (nextLocation.archetype != location.archetype || nextLocation.row != location.row + rowCount || nextLastReadComponentId == componentId) {
+                    break;
+                }
+                nextLastReadComponentId = componentId;
+                rowCount++;
+            }
+
+            if (!componentInfos[componentId].read(reader, archetype.GetComponent(location.row, componentId), rowCount)) {
+                return false;
+            }
+            i += rowCount;
+        }
+    }
+    for (unsigned int componentId = 0; componentId < MAX_COMPONENTS; componentId++) {
+        if (usedSignature.test(componentId) && !componentInfos[componentId].isTag && !readSignature.test(componentId)) {
+            return false;
+        }
+    }
+
+    // Put the entities back in the systems and groups they were in. Entities
+    // created together share their signature, so the systems interested in
+    // it are only looked up when it changes.
+    for (auto &system : systems) {
+        system.second->entityIdToIndex.assign(entityCount, System::INVALID_INDEX);
+        system.second->membershipVersion++;
+    }
+    const std::vector<System *> *interestedSystems = nullptr;
+    Signature interestedSignature;
+    for (unsigned int entityIndex = 0; entityIndex < entityCount; entityIndex++) {
+        const auto &matchedSignature = entityMatchedSignatures[entityIndex];
+        if (GetEntityIndex(entityIds[entityIndex]) != entityIndex || matchedSignature.none()) {
+            continue;
+        }
+
+        if (!interestedSystems || matchedSignature != interestedSignature) {
+            interestedSystems = &GetInterestedSystems(matchedSignature);
+            interestedSignature = matchedSignature;
+        }
+
+        // The systems were emptied, so the entity can't be in them already
+        for (auto system : *interestedSystems) {
+            system->entityIdToIndex[entityIndex] = system->entityIds.size();
+            system->entityIds.push_back(entityIds[entityIndex]);
+            system->AddEntityToOptionalPartitions(entityIds[entityIndex], matchedSignature);
+        }
+    }
+    for (const auto &group : groups) {
+        for (unsigned int entityIndex = 0; entityIndex < entityCount; entityIndex++) {
+            if (entityComponentSignatures[entityIndex].Contains(group.signature)) {
+                UpdateEntityGroup(entityIds[entityIndex], group.componentIds.front(), group.signature);
+            }
+        }
+    }
+
+    return true;
+}
+
+std::unique_ptr<World> World::Clone() const {
+    for (unsigned int componentId = 0; componentId < componentInfos.size(); componentId++) {
+        const auto &info = componentInfos[componentId];
+        if (info.size != 0 && !info.isTag && !info.copyConstruct) {
+            Logger::Error("Can't clone the world, component id = " + std::to_string(componentId) + " can't be copied");
+            return nullptr;
+        }
+    }
+    for (const auto &system : systems) {
+        if (!system.second->clone) {
+            Logger::Error("Can't clone the world, system " + std::string(system.first.name()) + " can't be copied");
+            return nullptr;
+        }
+    }
+
+    auto clone = std::make_unique<World>(storageMode);
+
+    clone->entitiesToBeCreated = entitiesToBeCreated;
+    clone->entitiesToBeDestroyed = entitiesToBeDestroyed;
+    clone->entitiesToBeRematched = entitiesToBeRematched;
+    clone->entityPendingFlags = entityPendingFlags;
+    clone->entityCapacity = entityCapacity;
+    clone->entityIds = entityIds;
+    clone->nextFreeIndex = nextFreeIndex;
+    clone->entityComponentSignatures = entityComponentSignatures;
+    clone->entityMatchedSignatures = entityMatchedSignatures;
+    clone->componentInfos = componentInfos;
+    clone->groups = groups;
+    clone->componentGroups = componentGroups;
+    clone->currentTick = GetTick();
+    for (unsigned int componentId = 0; componentId < MAX_COMPONENTS; componentId++) {
+        clone->componentChangedTicks[componentId].store(componentChangedTicks[componentId].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    // Both worlds now share the pools, the first to write to one copies it
+    clone->componentPools = componentPools;
+
+    clone->archetypes.reserve(archetypes.size());
+    for (const auto &archetype : archetypes) {
+        clone->archetypes.push_back(std::make_unique<Archetype>(*archetype));
+    }
+    clone->archetypeIndices = archetypeIndices;
+    clone->entityLocations = entityLocations;
+
+    // The copied systems keep their entities
+    for (const auto &system : systems) {
+        auto systemClone = system.second->clone(*system.second);
+        systemClone->world = clone.get();
+        clone->systems.emplace(system.first, std::move(systemClone));
+    }
+
+    clone->singletons.resize(singletons.size());
+    clone->singletonCopies = singletonCopies;
+    for (unsigned int singletonId = 0; singletonId < singletons.size(); singletonId++) {
+        if (singletons[singletonId] && singletonCopies[singletonId]) {
+            clone->singletons[singletonId] = singletonCopies[singletonId](singletons[singletonId].get());
+        }
+    }
+
+    Logger::Log("World cloned with " + std::to_string(entityIds.size()) + " entity slots");
+
+    return clone;
+}
@@ -2,15 +2,31 @@
 #define ECS_H
 
 #include "../Logger/Logger.h"
+#include "../Jobs/JobSystem.h"
 
 #include <iostream>
-#include <bitset>
+#include <tuple>
+#include <array>
+#include <type_traits>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <unordered_map>
 #include <typeindex>
-#include <set>
-#include <deque>
 #include <memory>
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cassert>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -18,26 +34,202 @@
 ////////////////////////////////////////////////////////////////////////////////
 // We use a bitset to keep track of which components an entity has. It also
 // helps keep track of which entities a system is intereseted in.
+// The width is set at build time with -DSIGNATURE_BITS=64, 128 or 256. The bits
+// are stored in aligned 64-bit words, so that wide signatures are matched with
+// vector instructions and a single word is matched with one AND/compare.
 ////////////////////////////////////////////////////////////////////////////////
-const unsigned int MAX_COMPONENTS = 32;
-typedef std::bitset<MAX_COMPONENTS> Signature;
+#ifndef SIGNATURE_BITS
+#define SIGNATURE_BITS 64
+#endif
+
+const unsigned int MAX_COMPONENTS = SIGNATURE_BITS;
+
+class Signature {
+    private:
+        static constexpr unsigned int NUM_WORDS = MAX_COMPONENTS / 64;
+        static_assert(MAX_COMPONENTS % 64 == 0 && NUM_WORDS <= 4, "SIGNATURE_BITS must be 64, 128 or 256");
+
+        alignas(NUM_WORDS == 1 ? 8 : 16) std::uint64_t words[NUM_WORDS] = {};
+
+    public:
+        constexpr Signature() = default;
+
+        // Bits past MAX_COMPONENTS are checked in debug builds only
+        constexpr bool test(unsigned int bit) const {
+            assert(bit < MAX_COMPONENTS && "Signature bit out of range");
+            return (words[bit / 64] >> (bit % 64)) & 1;
+        }
+
+        constexpr bool operator [](unsigned int bit) const { return test(bit); }
+
+        constexpr void set(unsigned int bit, bool value = true) {
+            assert(bit < MAX_COMPONENTS && "Signature bit out of range");
+            if (value) {
+                words[bit / 64] |= std::uint64_t(1) << (bit % 64);
+            } else {
+                words[bit / 64] &= ~(std::uint64_t(1) << (bit % 64));
+            }
+        }
+
+        constexpr void reset() {
+            for (auto &word : words) {
+                word = 0;
+            }
+        }
+
+        constexpr void reset(unsigned int bit) { set(bit, false); }
+
+        constexpr bool any() const {
+            std::uint64_t bits = 0;
+            for (auto word : words) {
+                bits |= word;
+            }
+            return bits != 0;
+        }
+
+        constexpr bool none() const { return !any(); }
+
+        // Checks whether all the bits of the other signature are set in this one,
+        // which is how entity signatures are matched against system signatures
+        bool Contains(const Signature &other) const {
+            if constexpr (NUM_WORDS == 1) {
+                return (words[0] & other.words[0]) == other.words[0];
+            } else {
+#if defined(__SSE2__)
+                // Accumulate the bits missing from this signature, then test them once
+                __m128i missing = _mm_setzero_si128();
+                for (unsigned int i = 0; i < NUM_WORDS; i += 2) {
+                    const auto a = _mm_load_si128(reinterpret_cast<const __m128i *>(&words[i]));
+                    const auto b = _mm_load_si128(reinterpret_cast<const __m128i *>(&other.words[i]));
+                    missing = _mm_or_si128(missing, _mm_andnot_si128(a, b));
+                }
+                return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xFFFF;
+#elif defined(__ARM_NEON)
+                uint64x2_t missing = vdupq_n_u64(0);
+                for (unsigned int i = 0; i < NUM_WORDS; i += 2) {
+                    missing = vorrq_u64(missing, vbicq_u64(vld1q_u64(&other.words[i]), vld1q_u64(&words[i])));
+                }
+                const uint32x4_t missingBits = vreinterpretq_u32_u64(missing);
+#if defined(__aarch64__)
+                return vmaxvq_u32(missingBits) == 0;
+#else
+                // ARMv7 has no across-vector max, fold the two halves instead
+                const uint32x2_t halves = vorr_u32(vget_low_u32(missingBits), vget_high_u32(missingBits));
+                return vget_lane_u32(vpmax_u32(halves, halves), 0) == 0;
+#endif
+#else
+                std::uint64_t missing = 0;
+                for (unsigned int i = 0; i < NUM_WORDS; i++) {
+                    missing |= other.words[i] & ~words[i];
+                }
+                return missing == 0;
+#endif
+            }
+        }
+
+        // Checks whether the two signatures have at least one bit in common
+        constexpr bool Intersects(const Signature &other) const {
+            std::uint64_t bits = 0;
+            for (unsigned int i = 0; i < NUM_WORDS; i++) {
+                bits |= words[i] & other.words[i];
+            }
+            return bits != 0;
+        }
+
+        constexpr Signature &operator |=(const Signature &other) {
+            for (unsigned int i = 0; i < NUM_WORDS; i++) {
+                words[i] |= other.words[i];
+            }
+            return *this;
+        }
+
+        constexpr Signature &operator &=(const Signature &other) {
+            for (unsigned int i = 0; i < NUM_WORDS; i++) {
+                words[i] &= other.words[i];
+            }
+            return *this;
+        }
+
+        constexpr Signature operator ~() const {
+            Signature result;
+            for (unsigned int i = 0; i < NUM_WORDS; i++) {
+                result.words[i] = ~words[i];
+            }
+            return result;
+        }
+
+        constexpr Signature operator |(const Signature &other) const { Signature result = *this; return result |= other; }
+        constexpr Signature operator &(const Signature &other) const { Signature result = *this; return result &= other; }
+
+        constexpr bool operator ==(const Signature &other) const {
+            std::uint64_t difference = 0;
+            for (unsigned int i = 0; i < NUM_WORDS; i++) {
+                difference |= words[i] ^ other.words[i];
+            }
+            return difference == 0;
+        }
+
+        constexpr bool operator !=(const Signature &other) const { return !(*this == other); }
+
+        std::size_t GetHash() const {
+            std::size_t hash = 0;
+            for (auto word : words) {
+                hash = hash * 0x9E3779B97F4A7C15ull + std::hash<std::uint64_t>()(word);
+            }
+            return hash;
+        }
+};
+
+namespace std {
+    template <>
+    struct hash<Signature> {
+        std::size_t operator ()(const Signature &signature) const { return signature.GetHash(); }
+    };
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // Entity
 ////////////////////////////////////////////////////////////////////////////////
-// An Entity is essential an ID that represents a game object.
+// An Entity is essential an ID that represents a game object. The id packs the
+// index of the entity slot in the world with the generation of that slot. The
+// generation is bumped every time the slot is freed, so a stale Entity never
+// aliases the new entity that reuses its index. A slot is retired once its
+// generations run out.
 ////////////////////////////////////////////////////////////////////////////////
+const unsigned int ENTITY_INDEX_BITS = 20;
+const unsigned int ENTITY_GENERATION_BITS = 32 - ENTITY_INDEX_BITS;
+const unsigned int ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+const unsigned int ENTITY_GENERATION_MASK = (1u << ENTITY_GENERATION_BITS) - 1;
+
+// The largest index is reserved to mark the end of the free list
+const unsigned int MAX_ENTITIES = ENTITY_INDEX_MASK;
+const unsigned int INVALID_ENTITY_ID = static_cast<unsigned int>(-1);
+
+inline unsigned int GetEntityIndex(unsigned int id) { return id & ENTITY_INDEX_MASK; }
+inline unsigned int GetEntityGeneration(unsigned int id) { return id >> ENTITY_INDEX_BITS; }
+inline unsigned int CreateEntityId(unsigned int index, unsigned int generation) {
+    return ((generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK);
+}
+
 class Entity {
     private:
-        unsigned int id;
+        unsigned int id = INVALID_ENTITY_ID;
 
     public:
         Entity() = default;
-        Entity(int id) : id(id) {};
+        Entity(unsigned int id) : id(id) {};
+        Entity(unsigned int id, class World *world) : id(id), world(world) {};
         Entity(const Entity &entity) = default;
         void Destroy();
+        bool IsAlive() const;
+
+        // The full id, including the generation
         unsigned int GetId() const;
 
+        // The index of the entity slot, used to index per-entity arrays
+        unsigned int GetIndex() const { return GetEntityIndex(id); }
+        unsigned int GetGeneration() const { return GetEntityGeneration(id); }
+
         Entity &operator =(const Entity &other) = default;
         bool operator ==(const Entity &other) const { return id == other.id; }
         bool operator !=(const Entity &other) const { return id != other.id; }
@@ -47,12 +239,51 @@ class Entity {
         bool operator >=(const Entity &other) const { return id >= other.id; }
 
         template <typename TComponent, typename ...TArgs> void AddComponent(TArgs &&...args);
+        template <typename ...TComponents> void AddComponents(TComponents &&...components);
         template <typename TComponent> void RemoveComponent();
         template <typename TComponent> bool HasComponent();
-        template <typename TComponent> TComponent &GetComponent() const;
+        template <typename TComponent> const std::remove_const_t<TComponent> &GetComponent() const;
+        template <typename TComponent> TComponent &GetMutableComponent() const;
 
         // Pointer to the entity's owner world
+        class World *world = nullptr;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Entity Range
+////////////////////////////////////////////////////////////////////////////////
+// A non-owning view over a packed list of entity ids. Entities are built on the
+// fly while iterating, so the list itself only needs to store the ids.
+////////////////////////////////////////////////////////////////////////////////
+class EntityRange {
+    private:
+        const unsigned int *first;
+        const unsigned int *last;
         class World *world;
+
+    public:
+        class Iterator {
+            private:
+                const unsigned int *current;
+                class World *world;
+
+            public:
+                Iterator(const unsigned int *current, class World *world) : current(current), world(world) {};
+
+                Entity operator *() const { return Entity(*current, world); }
+                Iterator &operator ++() { current++; return *this; }
+                bool operator ==(const Iterator &other) const { return current == other.current; }
+                bool operator !=(const Iterator &other) const { return current != other.current; }
+        };
+
+        EntityRange(const unsigned int *first, const unsigned int *last, class World *world) : first(first), last(last), world(world) {};
+
+        Iterator begin() const { return Iterator(first, world); }
+        Iterator end() const { return Iterator(last, world); }
+
+        bool IsEmpty() const { return first == last; }
+        std::size_t GetSize() const { return last - first; }
+        Entity operator [](std::size_t index) const { return Entity(first[index], world); }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -60,17 +291,111 @@ class Entity {
 ////////////////////////////////////////////////////////////////////////////////
 // A Component is pure data
 ////////////////////////////////////////////////////////////////////////////////
+// Component types can opt into compile-time ids by listing them once, after
+// their definitions, in a registry:
+//     REGISTER_COMPONENTS(TransformComponent, RigidBodyComponent, ...);
+// A registered type gets a constexpr id equal to its position in the list, so
+// its id is the same in every run and signatures made of registered types are
+// built at compile time. Types that aren't registered get their ids at runtime,
+// in order of first use, counting down from the last signature bit.
+////////////////////////////////////////////////////////////////////////////////
+template <typename ...TComponents>
+struct ComponentRegistry {
+    static constexpr unsigned int COUNT = sizeof...(TComponents);
+    static_assert(COUNT <= MAX_COMPONENTS, "Too many registered component types, increase SIGNATURE_BITS");
+
+    template <typename T>
+    static constexpr bool Contains() {
+        return (std::is_same_v<T, TComponents> || ...);
+    }
+
+    template <typename T>
+    static constexpr unsigned int GetId() {
+        unsigned int id = 0;
+        bool isFound = false;
+        ((isFound = isFound || std::is_same_v<T, TComponents>, id += isFound ? 0 : 1), ...);
+        return id;
+    }
+};
+
+// The registry in use, specialized by REGISTER_COMPONENTS
+template <typename TTag = void>
+struct RegisteredComponents {
+    using Registry = ComponentRegistry<>;
+};
+
+#define REGISTER_COMPONENTS(...) \
+    template <> struct RegisteredComponents<void> { using Registry = ComponentRegistry<__VA_ARGS__>; }
+
+// Looks the registry up through a dependent name, so that it's only resolved
+// where the component ids are used, after the registration
+template <typename T>
+using ComponentRegistryOf = typename RegisteredComponents<std::conditional_t<sizeof(T) != 0, void, T>>::Registry;
+
 struct IComponent {
     protected:
-        static unsigned int nextId;
+        static std::atomic<unsigned int> nextId;
+        static unsigned int CreateRuntimeId(unsigned int registeredCount);
 };
 
 // Used to assign a unique id to a component type
 template <typename T>
 class Component : public IComponent {
+    private:
+        static unsigned int GetRuntimeId() {
+            static auto id = CreateRuntimeId(ComponentRegistryOf<T>::COUNT);
+            return id;
+        }
+
+    public:
+        static constexpr bool IS_REGISTERED = ComponentRegistryOf<T>::template Contains<T>();
+
+        static constexpr unsigned int GetId() {
+            if constexpr (IS_REGISTERED) {
+                return ComponentRegistryOf<T>::template GetId<T>();
+            } else {
+                return GetRuntimeId();
+            }
+        }
+};
+
+// Const component types share the id of their type, views and GetComponent
+// use them for read-only access
+template <typename T>
+class Component<const T> : public Component<T> {};
+
+// Builds the signature of a set of component types, at compile time when all
+// of them are registered
+template <typename ...TComponents>
+constexpr Signature CreateSignature() {
+    Signature signature;
+    (signature.set(Component<TComponents>::GetId()), ...);
+    return signature;
+}
+
+// Empty component types are tags: they only set their bit in the signature of
+// the entity and have no storage, neither a pool nor an archetype column. They
+// are matched through the system signatures and HasComponent, not viewed.
+template <typename T>
+constexpr bool IsTagComponent = std::is_empty_v<std::remove_const_t<T>>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Singleton
+////////////////////////////////////////////////////////////////////////////////
+// Singletons are world resources that exist once per world, like the camera
+// or the input state, reached by type without going through an entity
+////////////////////////////////////////////////////////////////////////////////
+struct ISingleton {
+    protected:
+        static std::atomic<unsigned int> nextId;
+};
+
+// Used to assign a unique index to a singleton type
+template <typename T>
+class Singleton : public ISingleton {
     public:
         static unsigned int GetId() {
-            static auto id = nextId++;
+            static const auto id = nextId++;
             return id;
         }
 };
@@ -83,212 +408,2030 @@ class Component : public IComponent {
 class System {
     private:
         Signature componentSignature;
-        std::vector<Entity> entities;
+
+        // Components that keep an entity out of the system, and components
+        // an entity may or may not have
+        Signature excludedSignature;
+        Signature optionalSignature;
+
+        // Components the system reads and writes when it updates
+        Signature readSignature;
+        Signature writeSignature;
+
+        // Ids of the entities the system is interested in
+        // [Vector index = slot]
+        std::vector<unsigned int> entityIds;
+
+        // Slot of each entity in entityIds, or INVALID_INDEX
+        // [Vector index = entity index]
+        std::vector<unsigned int> entityIdToIndex;
+
+        // The entities of the system split on one optional component, the ones
+        // having it first. Kept in step as entities join, leave and get
+        // rematched, so the system never tests the component per entity.
+        struct OptionalPartition {
+            unsigned int componentId = 0;
+            unsigned int withCount = 0;
+
+            // [Vector index = position]
+            std::vector<unsigned int> entityIds;
+
+            // Position of each entity in entityIds, or INVALID_INDEX
+            // [Vector index = entity index]
+            std::vector<unsigned int> entityIdToIndex;
+
+            void Swap(unsigned int index, unsigned int otherIndex);
+            void Clear();
+        };
+        std::vector<OptionalPartition> optionalPartitions;
+
+        // Bumped whenever an entity joins or leaves the system, or gains or
+        // loses one of its optional components
+        unsigned int membershipVersion = 0;
+
+        // Copies the system with its entities for World::Clone, set by
+        // AddSystem when the system type is copyable
+        std::shared_ptr<System> (*clone)(const System &system) = nullptr;
+
+        // System updated by the scheduler on this thread, see RunAs
+        static thread_local const System *runningSystem;
+
+        // Moves a member between the sides of the optional partitions, called
+        // by the world when the entity joins the system or is rematched
+        void UpdateOptionalComponents(Entity entity, const Signature &entitySignature);
+        void AddEntityToOptionalPartitions(unsigned int entityId, const Signature &entitySignature);
+        void RemoveEntityFromOptionalPartitions(unsigned int entityIndex);
+        EntityRange GetOptionalEntities(unsigned int componentId, bool hasComponent) const;
+
+        friend class World;
+
+    protected:
+        // Pointer to the world the system was added to
+        class World *world = nullptr;
 
     public:
+        static constexpr unsigned int INVALID_INDEX = static_cast<unsigned int>(-1);
+
         System() = default;
         ~System() = default;
 
+        // Adding and removing are O(1), removing moves the last entity into
+        // the freed slot
         void AddEntityToSystem(Entity entity);
         void RemoveEntityFromSystem(Entity entity);
-        std::vector<Entity> GetSystemEntities() const;
+        bool HasEntity(Entity entity) const;
+
+        // Checks whether an entity with the given signature belongs in the system
+        bool IsInterested(const Signature &entitySignature) const;
+
+        EntityRange GetSystemEntities() const;
+
+        // Calls func(entity) for each entity of the system, split in chunks
+        // run in parallel on the job system
+        template <typename TFunc> void ParallelEach(JobSystem &jobSystem, TFunc func) const;
+        const std::vector<unsigned int> &GetSystemEntityIds() const;
         const Signature &GetComponentSignature() const;
 
-        // Defines the component type that entities must have to be considered by the system
-        template <typename TComponent> void RequireComponent();
+        // Changes whenever the entities of the system change, so that data
+        // derived from them only needs to be rebuilt when it differs
+        unsigned int GetMembershipVersion() const;
+
+        // Defines the component types that entities must have to be considered by the system
+        template <typename ...TComponents> void RequireComponent();
+
+        // Defines the component types that keep entities out of the system
+        template <typename ...TComponents> void ExcludeComponent();
+
+        // Defines component types that entities may have. They don't change
+        // which entities join the system, but the entities are sorted on them
+        // as they join or change, see GetSystemEntitiesWith. They count as
+        // reads for the scheduler when the system declares its accesses.
+        template <typename ...TComponents> void OptionalComponent();
+
+        // Entities of the system having, or lacking, one of its optional
+        // components, without testing each entity
+        template <typename TComponent> EntityRange GetSystemEntitiesWith() const;
+        template <typename TComponent> EntityRange GetSystemEntitiesWithout() const;
+
+        // Defines the component types the system reads and writes when it
+        // updates, so that the scheduler can run the systems that don't
+        // conflict in parallel. A system that declares neither is considered
+        // to conflict with every other system.
+        template <typename ...TComponents> void ReadComponent();
+        template <typename ...TComponents> void WriteComponent();
+
+        bool HasDeclaredAccess() const;
+        bool ConflictsWith(const System &other) const;
+
+        // Whether the system may write the component: it declared writing it,
+        // or declared no access at all
+        bool CanWrite(unsigned int componentId) const;
+
+        // Runs func as part of the system's update on the current thread. The
+        // scheduler runs each update this way, and the parallel iterations run
+        // their jobs as the system that started them, so that mutable access
+        // can be checked against the declared writes in debug builds.
+        template <typename TFunc> static void RunAs(const System *system, TFunc &&func);
+        static const System *GetRunningSystem() { return runningSystem; }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
-// Pool
+// Capacity Policy
 ////////////////////////////////////////////////////////////////////////////////
-// A pool is a vector of objects of type T
+// Storage owned by the world grows geometrically, starting from a minimum
+// capacity, so that the number of reallocations stays logarithmic no matter
+// how the standard library implements vector growth. Explicit reserves and
+// World::Compact are exact.
 ////////////////////////////////////////////////////////////////////////////////
-class IPool {
-    public:
-        virtual ~IPool() {} ;
-};
-
-template <typename T>
-class Pool : public IPool {
-    private:
-        std::vector<T> data;
+constexpr std::size_t MIN_STORAGE_CAPACITY = 64;
 
-    public:
-        Pool(int size = 100) { data.resize(size); }
-        virtual ~Pool() = default;
+inline std::size_t GrowCapacity(std::size_t capacity, std::size_t required) {
+    return std::max(required, std::max(capacity * 2, MIN_STORAGE_CAPACITY));
+}
 
-        bool IsEmpty() const { return data.empty(); }
-        int GetSize() const { return data.size(); }
-        void Resize(int n) { data.resize(n); }
-        void Clear() { data.clear(); }
-        void Add(T object) { data.push_back(object); }
-        void Set(int index, T object) { data[index] = object; }
-        T &Get(int index) { return static_cast<T &>(data[index]); }
-        T &operator [](unsigned int index) { return data[index]; }
-};
+template <typename T, typename TAllocator>
+void GrowVector(std::vector<T, TAllocator> &vector, std::size_t required) {
+    if (required > vector.capacity()) {
+        vector.reserve(GrowCapacity(vector.capacity(), required));
+    }
+}
 
 ////////////////////////////////////////////////////////////////////////////////
-// World
+// Snapshot
 ////////////////////////////////////////////////////////////////////////////////
-// The world manages the creation and destruction of entities, systems, and
-// components.
+// Snapshots are versioned binary dumps of a world, see World::SaveSnapshot.
+// Trivially copyable component types are copied as raw bytes, a whole pool at
+// a time. Other types, or types that need fixing up when restored (like the
+// ones holding entity handles), specialize ComponentSerializer:
+//     template <> struct ComponentSerializer<SpriteComponent> {
+//         static void Write(SnapshotWriter &writer, const SpriteComponent &sprite) {...}
+//         static bool Read(SnapshotReader &reader, SpriteComponent &sprite) {...}
+//     };
+// Component types that are neither can't be part of a snapshot. Component ids
+// are written as they are, so snapshots only carry over between runs for the
+// types listed in REGISTER_COMPONENTS.
 ////////////////////////////////////////////////////////////////////////////////
-class World {
+const unsigned int SNAPSHOT_MAGIC = 0x53434557; // "WECS"
+const unsigned int SNAPSHOT_VERSION = 1;
+
+class SnapshotWriter {
     private:
-        unsigned int numEntities = 0;
+        std::vector<unsigned char> &buffer;
 
-        std::set<Entity> entitiesToBeCreated;
-        std::set<Entity> entitiesToBeDestroyed;
+    public:
+        SnapshotWriter(std::vector<unsigned char> &buffer) : buffer(buffer) {};
 
-        // List of free entity ids that were previously removed
-        std::deque<unsigned int> freeIds;
+        void WriteBytes(const void *data, std::size_t size);
+        void WriteString(const std::string &string);
 
-        // Vector of component pools, each pool contains all the data for a
-        // certain component type.
-        // [Vector index = component type id]
-        // [Pool index = entity id]
-        std::vector<std::shared_ptr<IPool>> componentPools;
+        template <typename T> void Write(const T &value) {
+            static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written as bytes");
+            WriteBytes(&value, sizeof(T));
+        }
 
-        // Vector of component signatures per entity, saying which component
-        // is turned "on" for each entity.
-        // [Vector index = entity id]
-        std::vector<Signature> entityComponentSignatures;
+        // Writes the size of the vector followed by its elements
+        template <typename T, typename TAllocator> void WriteVector(const std::vector<T, TAllocator> &vector) {
+            Write<unsigned int>(vector.size());
+            WriteBytes(vector.data(), vector.size() * sizeof(T));
+        }
+};
 
-        std::unordered_map<std::type_index, std::shared_ptr<System>> systems;
+class SnapshotReader {
+    private:
+        const unsigned char *current;
+        const unsigned char *end;
+        class World *world;
 
     public:
-        World()  {
-            Logger::Log("World created");
+        SnapshotReader(const unsigned char *data, std::size_t size, class World *world) : current(data), end(data + size), world(world) {};
+
+        // The reads return false when the snapshot is too short
+        bool ReadBytes(void *data, std::size_t size);
+        bool ReadString(std::string &string);
+
+        template <typename T> bool Read(T &value) {
+            static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be read as bytes");
+            return ReadBytes(&value, sizeof(T));
         }
 
-        ~World() {
-            Logger::Log("World destroyed");
+        template <typename T, typename TAllocator> bool ReadVector(std::vector<T, TAllocator> &vector) {
+            unsigned int size;
+            if (!Read(size) || size > GetRemainingSize() / std::max<std::size_t>(sizeof(T), 1)) {
+                return false;
+            }
+            vector.resize(size);
+            return ReadBytes(vector.data(), size * sizeof(T));
         }
 
-        // Entity management
-        Entity CreateEntity();
-        void DestroyEntity(Entity entity);
+        std::size_t GetRemainingSize() const { return end - current; }
 
-        // Component management
-        template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs &&...args);
-        template <typename TComponent> void RemoveComponent(Entity entity);
-        template <typename TComponent> bool HasComponent(Entity entity) const;
-        template <typename TComponent> TComponent &GetComponent(Entity entity) const;
+        // World being restored, used to rebind the entity handles
+        class World *GetWorld() const { return world; }
+};
 
-        // System management
-        template <typename TSystem, typename ...TArgs> void AddSystem(TArgs &&...args);
-        template <typename TSystem> void RemoveSystem();
-        template <typename TSystem> bool HasSystem() const;
-        template <typename TSystem> TSystem &GetSystem() const;
+template <typename T>
+struct ComponentSerializer {};
 
-        // Checks the component signature of an entity and add the entity to the
-        // systems that are interested in it 
-        void AddEntityToSystems(Entity entity);
-        void RemoveEntityFromSystems(Entity entity);
+template <typename T, typename = void>
+constexpr bool HasComponentSerializer = false;
 
-        void Update();
+template <typename T>
+constexpr bool HasComponentSerializer<T, std::void_t<decltype(&ComponentSerializer<T>::Write)>> = true;
 
-};
+template <typename T>
+constexpr bool IsSerializableComponent = HasComponentSerializer<T> || std::is_trivially_copyable_v<T>;
 
-////////////////////////////////////////////////////////////////////////////////
-// Template Implementations
-////////////////////////////////////////////////////////////////////////////////
-template <typename TComponent, typename ...TArgs>
-void Entity::AddComponent(TArgs &&...args) {
-    world->AddComponent<TComponent>(*this, std::forward<TArgs>(args)...);
+template <typename T>
+void WriteComponents(SnapshotWriter &writer, const T *objects, std::size_t count) {
+    if constexpr (HasComponentSerializer<T>) {
+        for (std::size_t i = 0; i < count; i++) {
+            ComponentSerializer<T>::Write(writer, objects[i]);
+        }
+    } else if constexpr (std::is_trivially_copyable_v<T>) {
+        writer.WriteBytes(objects, count * sizeof(T));
+    }
 }
 
-template <typename TComponent>
-void Entity::RemoveComponent() {
-    world->RemoveComponent<TComponent>(*this);
+// Reads into objects that are already constructed
+template <typename T>
+bool ReadComponents(SnapshotReader &reader, T *objects, std::size_t count) {
+    if constexpr (HasComponentSerializer<T>) {
+        for (std::size_t i = 0; i < count; i++) {
+            if (!ComponentSerializer<T>::Read(reader, objects[i])) {
+                return false;
+            }
+        }
+        return true;
+    } else if constexpr (std::is_trivially_copyable_v<T>) {
+        return reader.ReadBytes(objects, count * sizeof(T));
+    } else {
+        return false;
+    }
 }
 
-template <typename TComponent>
-bool Entity::HasComponent() {
-    return world->HasComponent<TComponent>(*this);
-}
+////////////////////////////////////////////////////////////////////////////////
+// Pool
+////////////////////////////////////////////////////////////////////////////////
+// A pool is a sparse set of objects of type T. The component data and the ids
+// of their owning entities are kept packed in two dense vectors, while a sparse
+// vector maps entity indices to their position in the dense vectors. Memory
+// grows with the number of components instead of with the largest entity id.
+////////////////////////////////////////////////////////////////////////////////
+const std::size_t CACHE_LINE_SIZE = 64;
 
-template <typename TComponent>
-TComponent &Entity::GetComponent() const {
-    return world->GetComponent<TComponent>(*this);
-}
+// World ticks at which a component was added and last accessed mutably. The
+// world tick advances at every World::Update, and starts at 1 so that tick 0
+// is older than any component.
+struct ComponentTicks {
+    unsigned int added;
+    unsigned int changed;
+};
 
-// System
-template <typename TComponent>
-void System::RequireComponent() {
-    const auto componentId = Component<TComponent>::GetId();
-    componentSignature.set(componentId);
-}
+// Allocates the component data on cache line boundaries, so that jobs writing
+// to separate ranges of 64 components never share a cache line
+template <typename T>
+struct CacheAlignedAllocator {
+    using value_type = T;
 
-// World
-template <typename TComponent, typename ...TArgs>
-void World::AddComponent(Entity entity, TArgs &&...args) {
-    const auto componentId = Component<TComponent>::GetId();
-    const auto entityId = entity.GetId();
+    CacheAlignedAllocator() = default;
+    template <typename U> CacheAlignedAllocator(const CacheAlignedAllocator<U> &) {}
 
-    // Resize componentPools if necessary to accomadate new component
-    if (componentId >= componentPools.size()) {
-        componentPools.resize(componentId + 1, nullptr);
+    T *allocate(std::size_t count) {
+        return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(std::max(CACHE_LINE_SIZE, alignof(T)))));
     }
 
-    // Add new component pool if necessary
-    if (!componentPools[componentId]) {
-        std::shared_ptr<Pool<TComponent>> newComponentPool = std::make_shared<Pool<TComponent>>();
-        componentPools[componentId] = newComponentPool;
+    void deallocate(T *pointer, std::size_t) {
+        ::operator delete(pointer, std::align_val_t(std::max(CACHE_LINE_SIZE, alignof(T))));
     }
- 
-    // Get the component pool
-    std::shared_ptr<Pool<TComponent>> componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
 
-    // Resize componentPool if necessary to accomadate new entity
-    if (entityId >= static_cast<unsigned int>(componentPool->GetSize())) {
-        componentPool->Resize(entityId + 1);
-    }
+    template <typename U> bool operator ==(const CacheAlignedAllocator<U> &) const { return true; }
+    template <typename U> bool operator !=(const CacheAlignedAllocator<U> &) const { return false; }
+};
 
-    TComponent newComponent(std::forward<TArgs>(args)...);
+class IPool {
+    public:
+        virtual ~IPool() {} ;
+        virtual bool Has(unsigned int entityId) const = 0;
+        virtual void RemoveEntityFromPool(unsigned int entityId) = 0;
+        virtual ComponentTicks &GetTicks(unsigned int entityId) = 0;
+        virtual void ReserveEntities(unsigned int entityCount) = 0;
+        virtual void Compact() = 0;
+        virtual void Clear() = 0;
 
-    componentPool->Set(entityId, newComponent);
+        // Writes the components with the ids of their entities, or replaces the
+        // components with the ones read, stamped with the given tick
+        virtual void Save(SnapshotWriter &writer) const = 0;
+        virtual bool Load(SnapshotReader &reader, unsigned int tick) = 0;
 
-    entityComponentSignatures[entityId].set(componentId);
+        // Dense index of the component of an entity, or -1 if it has none
+        virtual unsigned int GetIndex(unsigned int entityId) const = 0;
 
-    Logger::Log("Component id = " + std::to_string(componentId) + " was added to entity id " + std::to_string(entityId));
-}
+        // Id of the entity owning each component
+        // [Vector index = dense index]
+        virtual const std::vector<unsigned int> &GetEntityIds() const = 0;
 
-template <typename TComponent>
-void World::RemoveComponent(Entity entity) {
-    const auto componentId = Component<TComponent>::GetId();
-    const auto entityId = entity.GetId();    
-    entityComponentSignatures[entityId].set(componentId, false);
+        // Exchanges two components in the dense vectors, used by the groups
+        // to keep their members packed at the front of the pools
+        virtual void Swap(unsigned int index, unsigned int otherIndex) = 0;
 
-    Logger::Log("Component id = " + std::to_string(componentId) + " was removed to entity id " + std::to_string(entityId));
-}
+        // Copies the pool with its components, or returns nullptr if they
+        // can't be copied
+        virtual std::shared_ptr<IPool> Clone() const = 0;
 
-template <typename TComponent>
-bool World::HasComponent(Entity entity) const {
-    const auto componentId = Component<TComponent>::GetId();
-    const auto entityId = entity.GetId();
-    return entityComponentSignatures[entityId].test(componentId);
-}
+        // Creates an empty pool of the same component type
+        virtual std::shared_ptr<IPool> CreateEmpty() const = 0;
+};
 
-template <typename TComponent>
-TComponent &World::GetComponent(Entity entity) const {
-    const auto componentId = Component<TComponent>::GetId();
-    const auto entityId = entity.GetId();
-    auto componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
+template <typename T>
+class Pool final : public IPool {
+    private:
+        static constexpr unsigned int INVALID_INDEX = static_cast<unsigned int>(-1);
 
-    return componentPool->Get(entityId);
-}
+        // Packed component data
+        // [Vector index = dense index]
+        std::vector<T, CacheAlignedAllocator<T>> data;
 
-template <typename TSystem, typename ...TArgs>
-void World::AddSystem(TArgs &&...args) {
-    std::shared_ptr<TSystem> newSystem = std::make_shared<TSystem>(std::forward<TArgs>(args)...);
-    systems.insert(std::make_pair(std::type_index(typeid(TSystem)), newSystem));
-}
+        // Change ticks of each component
+        // [Vector index = dense index]
+        std::vector<ComponentTicks, CacheAlignedAllocator<ComponentTicks>> ticks;
 
-template <typename TSystem>
-void World::RemoveSystem() {
-    auto system = systems.find(std::type_index(typeid(TSystem)));
-    systems.erase(system);
+        // Id of the entity owning each component
+        // [Vector index = dense index]
+        std::vector<unsigned int> entityIds;
+
+        // Dense index of the component of each entity, or INVALID_INDEX
+        // [Vector index = entity index]
+        std::vector<unsigned int> entityIdToIndex;
+
+    public:
+        Pool() = default;
+        virtual ~Pool() = default;
+
+        bool IsEmpty() const { return data.empty(); }
+        int GetSize() const { return data.size(); }
+
+        void Reserve(unsigned int capacity) {
+            data.reserve(capacity);
+            ticks.reserve(capacity);
+            entityIds.reserve(capacity);
+        }
+
+        // Makes room for required components, growing geometrically like Set
+        void Grow(unsigned int required) {
+            GrowVector(data, required);
+            GrowVector(ticks, required);
+            GrowVector(entityIds, required);
+        }
+
+        // Sizes the sparse vector for entity indices below entityCount
+        void ReserveEntities(unsigned int entityCount) override {
+            if (entityCount > entityIdToIndex.size()) {
+                entityIdToIndex.resize(entityCount, INVALID_INDEX);
+            }
+        }
+
+        // Releases the capacity that isn't used by the live components. This
+        // reallocates the dense vectors, so references to components are
+        // invalidated.
+        void Compact() override {
+            while (!entityIdToIndex.empty() && entityIdToIndex.back() == INVALID_INDEX) {
+                entityIdToIndex.pop_back();
+            }
+            data.shrink_to_fit();
+            ticks.shrink_to_fit();
+            entityIds.shrink_to_fit();
+            entityIdToIndex.shrink_to_fit();
+        }
+
+        void Clear() override {
+            data.clear();
+            ticks.clear();
+            entityIds.clear();
+            entityIdToIndex.clear();
+        }
+
+        void Save(SnapshotWriter &writer) const override {
+            writer.WriteVector(entityIds);
+            WriteComponents(writer, data.data(), data.size());
+        }
+
+        bool Load(SnapshotReader &reader, unsigned int tick) override {
+            // The sparse vector keeps its size, it's usually big enough already
+            data.clear();
+            ticks.clear();
+            entityIds.clear();
+            std::fill(entityIdToIndex.begin(), entityIdToIndex.end(), INVALID_INDEX);
+
+            if constexpr (!std::is_default_constructible_v<T>) {
+                return false;
+            } else {
+                if (!reader.ReadVector(entityIds)) {
+                    return false;
+                }
+
+                data.resize(entityIds.size());
+                if (!ReadComponents(reader, data.data(), data.size())) {
+                    return false;
+                }
+                ticks.assign(entityIds.size(), {tick, tick});
+
+                unsigned int entityCount = entityIdToIndex.size();
+                for (auto entityId : entityIds) {
+                    entityCount = std::max(entityCount, GetEntityIndex(entityId) + 1);
+                }
+                entityIdToIndex.resize(entityCount, INVALID_INDEX);
+
+                // An entity can't have two components of the same type
+                for (unsigned int index = 0; index < entityIds.size(); index++) {
+                    auto &entityIndex = entityIdToIndex[GetEntityIndex(entityIds[index])];
+                    if (entityIndex != INVALID_INDEX) {
+                        return false;
+                    }
+                    entityIndex = index;
+                }
+                return true;
+            }
+        }
+
+        bool Has(unsigned int entityId) const override {
+            const auto entityIndex = GetEntityIndex(entityId);
+            return entityIndex < entityIdToIndex.size() && entityIdToIndex[entityIndex] != INVALID_INDEX && entityIds[entityIdToIndex[entityIndex]] == entityId;
+        }
+
+        // Adds the component of an entity, or overwrites it if it already has
+        // one, stamping it with the given world tick
+        void Set(unsigned int entityId, T object, unsigned int tick) {
+            if (Has(entityId)) {
+                const auto index = entityIdToIndex[GetEntityIndex(entityId)];
+                data[index] = std::move(object);
+                ticks[index].changed = tick;
+                return;
+            }
+
+            const auto entityIndex = GetEntityIndex(entityId);
+            if (entityIndex >= entityIdToIndex.size()) {
+                GrowVector(entityIdToIndex, entityIndex + 1);
+                entityIdToIndex.resize(entityIndex + 1, INVALID_INDEX);
+            }
+
+            GrowVector(data, data.size() + 1);
+            GrowVector(ticks, ticks.size() + 1);
+            GrowVector(entityIds, entityIds.size() + 1);
+
+            entityIdToIndex[entityIndex] = data.size();
+            entityIds.push_back(entityId);
+            data.push_back(std::move(object));
+            ticks.push_back({tick, tick});
+        }
+
+        // Removes the component of an entity by moving the last component into
+        // its slot, keeping the dense vectors packed. The removed component is
+        // destroyed right away, releasing the resources it owns.
+        void Remove(unsigned int entityId) {
+            const auto entityIndex = GetEntityIndex(entityId);
+            const auto index = entityIdToIndex[entityIndex];
+            const auto lastIndex = data.size() - 1;
+
+            if (index != lastIndex) {
+                data[index] = std::move(data[lastIndex]);
+                ticks[index] = ticks[lastIndex];
+                entityIds[index] = entityIds[lastIndex];
+                entityIdToIndex[GetEntityIndex(entityIds[index])] = index;
+            }
+
+            data.pop_back();
+            ticks.pop_back();
+            entityIds.pop_back();
+            entityIdToIndex[entityIndex] = INVALID_INDEX;
+        }
+
+        void RemoveEntityFromPool(unsigned int entityId) override {
+            if (Has(entityId)) {
+                Remove(entityId);
+            }
+        }
+
+        unsigned int GetIndex(unsigned int entityId) const override {
+            return Has(entityId) ? entityIdToIndex[GetEntityIndex(entityId)] : INVALID_INDEX;
+        }
+
+        void Swap(unsigned int index, unsigned int otherIndex) override {
+            if (index == otherIndex) {
+                return;
+            }
+
+            std::swap(data[index], data[otherIndex]);
+            std::swap(ticks[index], ticks[otherIndex]);
+            std::swap(entityIds[index], entityIds[otherIndex]);
+            entityIdToIndex[GetEntityIndex(entityIds[index])] = index;
+            entityIdToIndex[GetEntityIndex(entityIds[otherIndex])] = otherIndex;
+        }
+
+        std::shared_ptr<IPool> Clone() const override {
+            if constexpr (std::is_copy_constructible_v<T>) {
+                return std::make_shared<Pool<T>>(*this);
+            } else {
+                return nullptr;
+            }
+        }
+
+        std::shared_ptr<IPool> CreateEmpty() const override {
+            return std::make_shared<Pool<T>>();
+        }
+
+        T &Get(unsigned int entityId) { return data[entityIdToIndex[GetEntityIndex(entityId)]]; }
+        ComponentTicks &GetTicks(unsigned int entityId) override { return ticks[entityIdToIndex[GetEntityIndex(entityId)]]; }
+
+        // Dense access, used to iterate over the live components only
+        T &operator [](unsigned int index) { return data[index]; }
+        T *GetDenseData() { return data.data(); }
+        ComponentTicks *GetDenseTicks() { return ticks.data(); }
+        const std::vector<T, CacheAlignedAllocator<T>> &GetData() const { return data; }
+        const std::vector<unsigned int> &GetEntityIds() const override { return entityIds; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Component Info
+////////////////////////////////////////////////////////////////////////////////
+// A type-erased description of a component type, so that storages which are
+// not templated on the component type can still move and destroy components.
+////////////////////////////////////////////////////////////////////////////////
+struct ComponentInfo {
+    std::size_t size = 0;
+    std::size_t alignment = 0;
+    void (*moveConstruct)(void *destination, void *source) = nullptr;
+    void (*destroy)(void *objects, std::size_t count) = nullptr;
+
+    // Copy constructs count objects, nullptr if the type can't be copied
+    void (*copyConstruct)(void *destination, const void *source, std::size_t count) = nullptr;
+
+    // Tags have no storage, archetypes don't give them a column
+    bool isTag = false;
+
+    // Snapshot support, the objects read must already be constructed unless
+    // they're read as raw bytes
+    bool isSerializable = false;
+    bool isReadAsBytes = false;
+    void (*defaultConstruct)(void *objects, std::size_t count) = nullptr;
+    void (*write)(SnapshotWriter &writer, const void *objects, std::size_t count) = nullptr;
+    bool (*read)(SnapshotReader &reader, void *objects, std::size_t count) = nullptr;
+
+    template <typename T> static ComponentInfo Create();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Archetype
+////////////////////////////////////////////////////////////////////////////////
+// An archetype stores all the entities that share the same signature. The
+// entities live in fixed-size chunks, and each chunk keeps one packed column
+// per component type (plus one column with the entity ids), so iterating over
+// an archetype streams through contiguous memory.
+////////////////////////////////////////////////////////////////////////////////
+const std::size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+const std::size_t ARCHETYPE_CHUNK_ALIGNMENT = 64;
+
+class Archetype {
+    private:
+        struct Column {
+            unsigned int componentId;
+            ComponentInfo info;
+            std::size_t offset;
+
+            // Offset of the change ticks of the components
+            std::size_t ticksOffset;
+        };
+
+        Signature signature;
+        std::vector<Column> columns;
+
+        // Column of each component type, or -1 if the archetype doesn't have it
+        // [Vector index = component type id]
+        std::vector<int> columnIndices;
+
+        unsigned int chunkCapacity = 0;
+        std::size_t chunkBytes = 0;
+        std::vector<unsigned char *> chunks;
+
+        // Number of entities, they are always packed into the first chunks
+        unsigned int size = 0;
+
+        unsigned char *GetAddress(unsigned int row, const Column &column) const;
+        ComponentTicks *GetTicksAddress(unsigned int row, const Column &column) const;
+
+    public:
+        static constexpr unsigned int INVALID_INDEX = static_cast<unsigned int>(-1);
+
+        Archetype(const Signature &signature, const std::vector<ComponentInfo> &componentInfos);
+        ~Archetype();
+
+        // Copies the rows with their components, which must be copyable
+        Archetype(const Archetype &other);
+        Archetype &operator =(const Archetype &) = delete;
+
+        const Signature &GetSignature() const { return signature; }
+        unsigned int GetSize() const { return size; }
+        unsigned int GetChunkCapacity() const { return chunkCapacity; }
+        unsigned int GetChunkCount() const { return (size + chunkCapacity - 1) / chunkCapacity; }
+        unsigned int GetChunkSize(unsigned int chunk) const;
+
+        bool HasColumn(unsigned int componentId) const {
+            return componentId < columnIndices.size() && columnIndices[componentId] >= 0;
+        }
+
+        // Appends a row for the entity, its component columns and their ticks
+        // are left uninitialized and must be set by the caller
+        unsigned int AddRow(unsigned int entityId);
+
+        // Destroys the components of a row and moves the last row into it.
+        // Returns the id of the entity that was moved, or INVALID_INDEX.
+        unsigned int RemoveRow(unsigned int row);
+
+        // Allocates the chunks needed to hold rowCount rows
+        void Reserve(unsigned int rowCount);
+
+        // Frees the chunks that don't hold any row
+        void Compact();
+
+        // Destroys every row, the chunks are kept for the next rows
+        void Clear();
+
+        // Moves the components of a row that also exist in the other archetype,
+        // with their ticks, into the given row of the other archetype
+        void MoveRow(unsigned int row, Archetype &other, unsigned int otherRow);
+
+        void *GetComponent(unsigned int row, unsigned int componentId) const;
+        ComponentTicks &GetTicks(unsigned int row, unsigned int componentId) const;
+
+        // Chunk access, used to stream through the packed columns
+        unsigned int *GetEntityIds(unsigned int chunk) const;
+        template <typename T> T *GetColumn(unsigned int chunk, unsigned int componentId) const;
+        ComponentTicks *GetTicksColumn(unsigned int chunk, unsigned int componentId) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// View
+////////////////////////////////////////////////////////////////////////////////
+// A view iterates over all the entities that have every component of a set of
+// component types. The storage is resolved once per iteration, so the callback
+// receives plain references without any per-entity lookup through the world.
+// Example: world->View<TransformComponent, RigidBodyComponent>().Each(
+//              [](TransformComponent &transform, RigidBodyComponent &rigidbody) {...});
+// The callback can also take the Entity as its first parameter. Components of
+// the viewed types must not be added or removed while iterating.
+// Viewing a const type gives read-only access, the other viewed components are
+// marked as changed. Changed<T>(tick) and Added<T>(tick) filter the entities
+// on the change ticks of one of the viewed types.
+// Example: world->View<const TransformComponent>().Changed<TransformComponent>(lastTick).Each(...);
+////////////////////////////////////////////////////////////////////////////////
+
+// Number of entities handed to each job by the parallel iterations: about a
+// chunk worth of rows, rounded to a multiple of 64 so that the ranges of two
+// jobs start on separate cache lines of the dense arrays they are cut from.
+// This only holds for the arrays walked in dense order (the walked pool of a
+// view, every pool of a group); components a view looks up through the sparse
+// set may still share a cache line between two jobs.
+inline unsigned int GetParallelChunkSize(std::size_t rowSize) {
+    const auto rowCount = std::max<std::size_t>(ARCHETYPE_CHUNK_SIZE / rowSize, 1);
+    return (rowCount + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+template <typename ...TComponents>
+class ComponentView {
+    static_assert(!(IsTagComponent<TComponents> || ...), "Tag components have no storage to view, require them in a system signature instead");
+
+    private:
+        static constexpr std::size_t COMPONENT_COUNT = sizeof...(TComponents);
+        static constexpr std::array<bool, COMPONENT_COUNT> IS_MUTABLE = {!std::is_const_v<TComponents>...};
+
+        using Pools = std::tuple<Pool<std::remove_const_t<TComponents>> *...>;
+        using Ticks = std::array<ComponentTicks *, COMPONENT_COUNT>;
+
+        class World *world;
+
+        // Ticks the components must have changed or been added after, 0 when
+        // the component isn't filtered
+        // [Array index = position of the type in TComponents]
+        std::array<unsigned int, COMPONENT_COUNT> changedAfter {};
+        std::array<unsigned int, COMPONENT_COUNT> addedAfter {};
+
+        template <typename T> static constexpr std::size_t IndexOf();
+
+        bool HasFilters() const;
+        bool PassesFilters(const Ticks &ticks) const;
+
+        // Fetches the pools of the viewed types and the entity ids of the
+        // smallest one, returns false if any of the types was never added
+        bool GetPools(Pools &pools, const std::vector<unsigned int> *&entityIds) const;
+
+        template <typename TFunc> void EachInPools(TFunc &func, const Pools &pools, const unsigned int *first, const unsigned int *last) const;
+        template <typename TFunc> void EachInChunk(TFunc &func, const Archetype &archetype, unsigned int chunk) const;
+
+    public:
+        ComponentView(class World *world) : world(world) {};
+
+        // Keeps only the entities whose T component changed (or was added)
+        // after the given tick, T being one of the viewed types
+        template <typename T> ComponentView Changed(unsigned int tick) const;
+        template <typename T> ComponentView Added(unsigned int tick) const;
+
+        template <typename TFunc> void Each(TFunc func) const;
+
+        // Same as Each, with the entities split in cache-sized chunks run in
+        // parallel on the job system. The callback may be called concurrently,
+        // it must only write to the components it receives. With pools, the
+        // chunks are cut from the smallest viewed pool, so the jobs writing to
+        // the other viewed pools can touch the same cache lines.
+        template <typename TFunc> void ParallelEach(JobSystem &jobSystem, TFunc func) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Group
+////////////////////////////////////////////////////////////////////////////////
+// A group owns the pools of a set of component types, and keeps them sorted so
+// that the entities having all of them sit at the front of every pool, in the
+// same order. Iterating over a group walks the pools side by side, without
+// looking up any entity. A pool can be owned by a single group.
+// Example: world->AddGroup<TransformComponent, RigidBodyComponent>();
+//          world->Group<TransformComponent, const RigidBodyComponent>().Each(
+//              [](TransformComponent &transform, const RigidBodyComponent &rigidbody) {...});
+// Groups only apply to STORAGE_POOLS, archetypes already pack the components
+// of an entity together. Without a matching group, iterating falls back to a
+// view of the same types.
+////////////////////////////////////////////////////////////////////////////////
+template <typename ...TComponents>
+class ComponentGroup {
+    static_assert(!(IsTagComponent<TComponents> || ...), "Tag components have no pool to group");
+
+    private:
+        using Pools = std::tuple<Pool<std::remove_const_t<TComponents>> *...>;
+
+        class World *world;
+
+        // Index of the group in the world, or World::INVALID_GROUP
+        unsigned int groupIndex;
+
+        template <typename TFunc> void EachInRange(TFunc &func, const Pools &pools, unsigned int begin, unsigned int end) const;
+
+    public:
+        ComponentGroup(class World *world, unsigned int groupIndex) : world(world), groupIndex(groupIndex) {};
+
+        // Number of entities having all the components of the group, 0 when
+        // there is no matching group
+        unsigned int GetSize() const;
+
+        template <typename TFunc> void Each(TFunc func) const;
+
+        // Same as Each, with the members split in cache-sized ranges run in
+        // parallel on the job system
+        template <typename TFunc> void ParallelEach(JobSystem &jobSystem, TFunc func) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Command Buffer
+////////////////////////////////////////////////////////////////////////////////
+// A command buffer records structural changes (creating and destroying
+// entities, adding and removing components) made from jobs, where the world
+// can't be modified. Each thread records into its own buffer without locking,
+// and the world plays all the buffers back at the start of its next update.
+// Commands are played back sorted by the key they were recorded with, so the
+// result doesn't depend on which thread ran which job. Keys should identify
+// the unit of work recording them, like the index of the processed entity.
+// Example: world->GetCommandBuffer().DestroyEntity(entity.GetIndex(), entity);
+////////////////////////////////////////////////////////////////////////////////
+// An entity created by a command buffer, it only exists once the buffer is
+// played back. Commands on it are played with the key it was created with.
+struct DeferredEntity {
+    unsigned int index;
+    unsigned int sortKey;
+};
+
+enum CommandType {
+    COMMAND_CREATE_ENTITY,
+    COMMAND_DESTROY_ENTITY,
+    COMMAND_ADD_COMPONENT,
+    COMMAND_REMOVE_COMPONENT
+};
+
+const std::size_t COMMAND_BLOCK_SIZE = 16 * 1024;
+
+class CommandBuffer {
+    private:
+        struct Command {
+            CommandType type;
+            unsigned int sortKey;
+
+            // Id of the entity, or index of the deferred entity
+            unsigned int entityId;
+            bool isDeferred;
+
+            // Component to add, owned by the buffer until it's played
+            void *component;
+            void (*play)(class World &world, Entity entity, void *component);
+            void (*destroy)(void *component);
+        };
+
+        struct Block {
+            unsigned char *data;
+            std::size_t size;
+        };
+
+        std::vector<Command> commands;
+
+        // Entities created during the playback
+        // [Vector index = deferred entity index]
+        std::vector<Entity> createdEntities;
+        unsigned int deferredEntityCount = 0;
+
+        // Memory holding the recorded components. The blocks are kept and
+        // reused once the buffer is cleared.
+        std::vector<Block> blocks;
+        unsigned int blockIndex = 0;
+        std::size_t blockOffset = 0;
+
+        void *Allocate(std::size_t size, std::size_t alignment);
+        template <typename TComponent, typename ...TArgs> void RecordAddComponent(unsigned int sortKey, unsigned int entityId, bool isDeferred, TArgs &&...args);
+
+        friend class World;
+
+    public:
+        CommandBuffer() = default;
+        ~CommandBuffer();
+
+        CommandBuffer(const CommandBuffer &) = delete;
+        CommandBuffer &operator =(const CommandBuffer &) = delete;
+
+        bool IsEmpty() const { return commands.empty(); }
+
+        DeferredEntity CreateEntity(unsigned int sortKey);
+        void DestroyEntity(unsigned int sortKey, Entity entity);
+        template <typename TComponent, typename ...TArgs> void AddComponent(unsigned int sortKey, Entity entity, TArgs &&...args);
+        template <typename TComponent, typename ...TArgs> void AddComponent(DeferredEntity entity, TArgs &&...args);
+        template <typename TComponent> void RemoveComponent(unsigned int sortKey, Entity entity);
+
+        // Drops the recorded commands without playing them
+        void Clear();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// World
+////////////////////////////////////////////////////////////////////////////////
+// The world manages the creation and destruction of entities, systems, and
+// components. Components are stored either in one pool per component type, or
+// in archetypes grouping the entities that share the same signature.
+////////////////////////////////////////////////////////////////////////////////
+enum StorageMode {
+    STORAGE_POOLS,
+    STORAGE_ARCHETYPES
+};
+
+// Changes an entity is waiting for until the next World::Update
+enum PendingFlag {
+    PENDING_CREATE = 1 << 0,
+    PENDING_DESTROY = 1 << 1,
+    PENDING_REMATCH = 1 << 2
+};
+
+// Changes to the components of entities that observers are notified of
+enum ComponentEvent {
+    COMPONENT_ADDED,
+    COMPONENT_REMOVED,
+    COMPONENT_DESTROYED,
+    COMPONENT_EVENT_COUNT
+};
+
+class World {
+    private:
+        StorageMode storageMode;
+
+        // Ids of the entities waiting for the next update. The buffers keep
+        // their capacity between updates, and the pending flags make sure an
+        // entity is queued at most once per buffer.
+        std::vector<unsigned int> entitiesToBeCreated;
+        std::vector<unsigned int> entitiesToBeDestroyed;
+
+        // Entities whose signature changed since the last update, they are
+        // matched against the systems again in a single batch
+        std::vector<unsigned int> entitiesToBeRematched;
+
+        // PendingFlag bits of each entity
+        // [Vector index = entity index]
+        std::vector<unsigned char> entityPendingFlags;
+
+        // Number of entities the per-entity storage is sized for, applied to
+        // the pools registered later as well
+        unsigned int entityCapacity = 0;
+
+        // Id of the entity living in each slot. Free slots form a linked list:
+        // their index bits hold the next free slot and their generation bits
+        // hold the generation the slot will have once it's reused.
+        // [Vector index = entity index]
+        std::vector<unsigned int> entityIds;
+
+        // First slot of the free list, or MAX_ENTITIES if there is none
+        unsigned int nextFreeIndex = MAX_ENTITIES;
+
+        // Vector of component pools, each pool contains all the data for a
+        // certain component type.
+        // [Vector index = component type id]
+        // [Pool index = entity index]
+        // Clones share the pools until one of them writes to a pool, it then
+        // gets a copy of its own. Mutable so that const accessors handing out
+        // mutable components can copy the pool.
+        mutable std::vector<std::shared_ptr<IPool>> componentPools;
+
+        // Pool of the component type, copied first if it's shared with a clone
+        IPool *GetWritablePool(unsigned int componentId) const;
+
+        // Asserts that the system running on this thread, if any, declared
+        // writing the component. Checked in debug builds only.
+        void CheckWriteAccess([[maybe_unused]] unsigned int componentId) const {
+            assert((!System::GetRunningSystem() || System::GetRunningSystem()->CanWrite(componentId)) && "Mutable access without WriteComponent");
+        }
+
+        // Vector of component signatures per entity, saying which component
+        // is turned "on" for each entity.
+        // [Vector index = entity index]
+        std::vector<Signature> entityComponentSignatures;
+
+        // Signature each entity had when it was last matched against the
+        // systems, so removal only visits the systems that took the entity
+        // [Vector index = entity index]
+        std::vector<Signature> entityMatchedSignatures;
+
+        // Archetypes used when the world is in STORAGE_ARCHETYPES mode
+        std::vector<std::unique_ptr<Archetype>> archetypes;
+        std::unordered_map<Signature, unsigned int> archetypeIndices;
+
+        // Type-erased info of every component type added to the world
+        // [Vector index = component type id]
+        std::vector<ComponentInfo> componentInfos;
+
+        // Archetype and row of each entity in STORAGE_ARCHETYPES mode
+        // [Vector index = entity index]
+        struct EntityLocation {
+            unsigned int archetype = Archetype::INVALID_INDEX;
+            unsigned int row = Archetype::INVALID_INDEX;
+        };
+        std::vector<EntityLocation> entityLocations;
+
+        std::unordered_map<std::type_index, std::shared_ptr<System>> systems;
+
+        // Systems interested in each entity signature seen so far, so entities
+        // sharing a signature are matched with a single lookup. It's cleared
+        // whenever a system is added or removed.
+        std::unordered_map<Signature, std::vector<System *>> systemsBySignature;
+
+        // Systems scheduled for the next RunScheduledSystems call, in order
+        struct ScheduledSystem {
+            System *system;
+            std::function<void(System &)> update;
+            unsigned int firstDependent;
+            unsigned int dependentCount;
+            // Number of earlier systems it waits for
+            unsigned int dependencyCount;
+        };
+        std::vector<ScheduledSystem> scheduledSystems;
+
+        // Later systems that conflict with each scheduled system, they wait
+        // for it to finish. Each scheduled system owns a contiguous range.
+        std::vector<unsigned int> scheduledDependents;
+
+        // Number of unfinished systems each scheduled system waits for
+        // [Array index = scheduled system index]
+        std::unique_ptr<std::atomic<unsigned int>[]> scheduledDependencyCounts;
+        unsigned int scheduledDependencyCapacity = 0;
+
+        JobSystem *scheduleJobSystem = nullptr;
+        JobCounter scheduleCounter;
+
+        void RunScheduledSystem(unsigned int index);
+
+        // Command buffer of each thread of the job system
+        // [Vector index = job system thread index]
+        std::vector<std::unique_ptr<CommandBuffer>> commandBuffers;
+
+        // Commands of all the buffers in playback order, reused every update
+        struct PlaybackCommand {
+            unsigned int sortKey;
+            unsigned int bufferIndex;
+            unsigned int commandIndex;
+        };
+        std::vector<PlaybackCommand> playbackCommands;
+
+        void PlayCommandBuffers();
+
+        const std::vector<System *> &GetInterestedSystems(const Signature &signature);
+
+        void MarkEntityToBeRematched(Entity entity);
+
+        // Allocates an entity and queues it for creation, without logging
+        Entity AllocateEntity();
+
+        // Constructs a component in the archetype row of an entity, or assigns
+        // it if the row already holds one
+        template <typename TComponent, typename ...TArgs> void ConstructInArchetype(unsigned int entityId, bool isConstructed, TArgs &&...args);
+
+        unsigned int GetOrCreateArchetype(const Signature &signature);
+
+        // Moves an entity to the archetype of the given signature, the
+        // components that are new to the entity are left uninitialized
+        void MoveEntityToArchetype(unsigned int entityId, const Signature &signature);
+        void RemoveEntityFromArchetype(unsigned int entityId);
+        void *GetComponentAddress(unsigned int entityId, unsigned int componentId) const;
+        ComponentTicks &GetComponentTicks(unsigned int entityId, unsigned int componentId) const;
+
+        // Tick stamped on the components that are added or accessed mutably
+        std::atomic<unsigned int> currentTick {1};
+
+        // Latest tick any component of each type was stamped with, so that
+        // consumers can skip a type that didn't change at all
+        // [Array index = component type id]
+        mutable std::array<std::atomic<unsigned int>, MAX_COMPONENTS> componentChangedTicks {};
+
+        void MarkComponentChanged(unsigned int componentId) const {
+            // Only ever raised, and read before it's written so that the jobs
+            // writing the same type don't keep taking the cache line
+            const auto tick = GetTick();
+            auto changedTick = componentChangedTicks[componentId].load(std::memory_order_relaxed);
+            while (changedTick < tick && !componentChangedTicks[componentId].compare_exchange_weak(changedTick, tick, std::memory_order_relaxed)) {}
+        }
+
+        // Marks the mutable types of a view or group, called once the tick
+        // they stamp has been read
+        template <typename ...TComponents> void MarkComponentsChanged() const {
+            ((std::is_const_v<TComponents> ? void() : MarkComponentChanged(Component<TComponents>::GetId())), ...);
+        }
+
+        // Removes every entity and component, keeping the systems, the groups
+        // and the capacity
+        void ClearEntities();
+        bool ReadSnapshot(SnapshotReader &reader);
+
+        // Singleton resources, type-erased so the right destructor still runs
+        // [Vector index = singleton type id]
+        std::vector<std::shared_ptr<void>> singletons;
+
+        // Copies each singleton for World::Clone, nullptr if it can't be copied
+        // [Vector index = singleton type id]
+        std::vector<std::shared_ptr<void> (*)(const void *singleton)> singletonCopies;
+
+        // Owning groups, used in STORAGE_POOLS mode
+        struct GroupInfo {
+            Signature signature;
+            std::vector<unsigned int> componentIds;
+
+            // Number of members, packed at the front of the owned pools
+            unsigned int size = 0;
+        };
+        std::vector<GroupInfo> groups;
+
+        // Group owning each component pool, or INVALID_GROUP
+        // [Vector index = component type id]
+        std::vector<unsigned int> componentGroups;
+
+        void CreateGroup(const Signature &signature);
+        unsigned int FindGroup(const Signature &signature) const;
+
+        // Moves an entity into or out of the group owning the component, if
+        // any, to match the signature the entity is going to have. Called
+        // after the component is added, or before it's removed.
+        void UpdateEntityGroup(unsigned int entityId, unsigned int componentId, const Signature &signature);
+
+        template <typename ...TComponents> friend class ComponentView;
+        template <typename ...TComponents> friend class ComponentGroup;
+
+        // Observers of a component event for one component type, with the
+        // entities the event happened to, collected during the update
+        struct ComponentObservers {
+            std::vector<std::function<void(EntityRange)>> callbacks;
+            std::vector<unsigned int> entityIds;
+        };
+
+        // [Array index = ComponentEvent][Vector index = component type id]
+        std::array<std::vector<ComponentObservers>, COMPONENT_EVENT_COUNT> componentObservers;
+
+        // Component types that have observers, so unobserved changes cost a
+        // single signature test
+        // [Array index = ComponentEvent]
+        std::array<Signature, COMPONENT_EVENT_COUNT> observedSignatures;
+
+        void AddObserver(ComponentEvent event, unsigned int componentId, std::function<void(EntityRange)> callback);
+
+        // Queues the entity for the observers of the components of the signature
+        void RecordComponentEvent(ComponentEvent event, unsigned int entityId, const Signature &signature);
+
+        // Calls the observers of the event with all the entities queued for them
+        void DispatchComponentEvent(ComponentEvent event);
+
+    public:
+        static constexpr unsigned int INVALID_GROUP = static_cast<unsigned int>(-1);
+
+        World(StorageMode storageMode = STORAGE_POOLS) : storageMode(storageMode) {
+            ReserveCommandBuffers(1);
+            Logger::Log("World created");
+        }
+
+        ~World() {
+            Logger::Log("World destroyed");
+        }
+
+        // Entity management
+        Entity CreateEntity();
+        void DestroyEntity(Entity entity);
+
+        // Creates count entities at once, each with a copy of the given
+        // components. Pools are grown once and the batch is logged once.
+        template <typename ...TComponents> std::vector<Entity> CreateEntities(unsigned int count, const TComponents &...components);
+
+        // Capacity hints, used to size the storage up front so that it doesn't
+        // reallocate mid-frame. Reserve allocates room for count entities
+        // having the given components: in their pools, or in the chunks of
+        // their archetype.
+        void ReserveEntities(unsigned int count);
+        template <typename ...TComponents> void Reserve(unsigned int count);
+
+        // Releases the memory that isn't used by live entities and components,
+        // meant for level transitions. References to components are invalidated.
+        void Compact();
+
+        // Snapshots, for quicksaves, checkpoints and rollback. SaveSnapshot
+        // writes the entities, their components and the pending changes to a
+        // buffer, RestoreSnapshot replaces the content of the world with it.
+        // The restoring world must have registered the component types and
+        // added the systems of the saved one, its storage mode may differ.
+        // Restored components count as added at the restore tick. Singletons
+        // and unplayed command buffers aren't saved. Both return false on
+        // error, a failed restore leaves the world empty.
+        bool SaveSnapshot(std::vector<unsigned char> &buffer) const;
+        bool RestoreSnapshot(const std::vector<unsigned char> &buffer);
+
+        // Forks the world, for prediction and rollback. The clone has the same
+        // entities, systems with the same entities, groups and tick. It shares
+        // the component pools with this world until either writes to one of
+        // them, so cloning costs about the per-entity arrays and the systems.
+        // Archetypes are copied right away. Singletons are copied, the ones
+        // that can't be are left out, as are observers, unplayed command
+        // buffers and scheduled systems. Entities stored in components still
+        // refer to this world, only their ids should be used in the clone.
+        // Returns nullptr if a component type or a system can't be copied.
+        std::unique_ptr<World> Clone() const;
+
+        // Checks that the entity hasn't been destroyed, even if its index has
+        // been reused since
+        bool IsAlive(Entity entity) const {
+            return entity.GetIndex() < entityIds.size() && entityIds[entity.GetIndex()] == entity.GetId();
+        }
+
+        // Component management
+        template <typename TComponent> Pool<TComponent> *RegisterComponent();
+        template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs &&...args);
+        template <typename ...TComponents> void AddComponents(Entity entity, TComponents &&...components);
+        template <typename TComponent> void RemoveComponent(Entity entity);
+        template <typename TComponent> bool HasComponent(Entity entity) const;
+        // GetComponent only reads, GetMutableComponent marks the component as
+        // changed and, inside a scheduled system, requires WriteComponent<T>
+        template <typename TComponent> const std::remove_const_t<TComponent> &GetComponent(Entity entity) const;
+        template <typename TComponent> TComponent &GetMutableComponent(Entity entity) const;
+
+        // Singleton management, see Singleton. SetSingleton replaces the
+        // instance if there was one already.
+        template <typename TSingleton, typename ...TArgs> TSingleton &SetSingleton(TArgs &&...args);
+        template <typename TSingleton> void RemoveSingleton();
+        template <typename TSingleton> bool HasSingleton() const;
+        template <typename TSingleton> TSingleton &GetSingleton() const;
+
+        // Component observers, for keeping derived data such as a spatial
+        // index in sync without scanning the world. Changes are collected
+        // until the next update, which calls func(EntityRange entities) once
+        // per event and component type with all the entities concerned:
+        // - OnAdd: the entities that gained the component, once matched
+        // - OnRemove: the living entities that lost it
+        // - OnDestroy: the entities destroyed while they had it when last
+        //   matched, called before they're destroyed
+        // A component added and removed between two updates isn't reported.
+        // Structural changes made by observers are reported at the next
+        // update. Observers can't be added from an observer, and restoring a
+        // snapshot doesn't notify them.
+        template <typename TComponent, typename TFunc> void OnAdd(TFunc func);
+        template <typename TComponent, typename TFunc> void OnRemove(TFunc func);
+        template <typename TComponent, typename TFunc> void OnDestroy(TFunc func);
+
+        // System management
+        template <typename TSystem, typename ...TArgs> void AddSystem(TArgs &&...args);
+        template <typename TSystem> void RemoveSystem();
+        template <typename TSystem> bool HasSystem() const;
+        template <typename TSystem> TSystem &GetSystem() const;
+
+        // Queues a system update for the next RunScheduledSystems call, func
+        // receives the system. Updates are expected to read and write only
+        // the components the system declared.
+        template <typename TSystem, typename TFunc> void ScheduleSystem(TFunc func);
+
+        // Runs the scheduled systems on the job system and waits for them.
+        // Systems whose declared accesses don't conflict run concurrently,
+        // conflicting ones run in the order they were scheduled.
+        void RunScheduledSystems(JobSystem &jobSystem);
+
+        // Command buffers, used to make structural changes from jobs. Every
+        // thread that records needs a buffer, which has to be reserved before
+        // the jobs start. RunScheduledSystems reserves one per thread of its
+        // job system.
+        void ReserveCommandBuffers(unsigned int threadCount);
+        CommandBuffer &GetCommandBuffer();
+
+        // Checks the component signature of an entity and add the entity to the
+        // systems that are interested in it 
+        void AddEntityToSystems(Entity entity);
+        void RemoveEntityFromSystems(Entity entity);
+
+        // Adds or removes the entity only from the systems whose match changed
+        // since the entity was last matched
+        void RematchEntityWithSystems(Entity entity);
+
+        void Update();
+
+        // Component iteration
+        template <typename ...TComponents> ComponentView<TComponents...> View() { return ComponentView<TComponents...>(this); }
+        // Pool of T, or of the type without const. Pools of non-const types
+        // are copied first if they're shared with a clone.
+        template <typename TComponent> Pool<std::remove_const_t<TComponent>> *GetComponentPool() const;
+
+        // Owning groups, see ComponentGroup. A group is declared once, before
+        // the systems update, then looked up by its types when iterating.
+        // Const types only change how the components are accessed.
+        template <typename ...TComponents> void AddGroup();
+        template <typename ...TComponents> ComponentGroup<TComponents...> Group() { return ComponentGroup<TComponents...>(this, FindGroup(CreateSignature<TComponents...>())); }
+
+        // Change tracking. GetMutableComponent<T> and views of T stamp the
+        // components with the current tick, while GetComponent<T> and views of
+        // const T leave them untouched. The tick advances at every update.
+        // A consumer of the changes records the tick returned by AdvanceTick
+        // when it runs, and next time filters the components changed after it:
+        // later changes get a newer tick, even within the same update.
+        unsigned int GetTick() const { return currentTick.load(std::memory_order_relaxed); }
+        unsigned int AdvanceTick() { return currentTick.fetch_add(1, std::memory_order_relaxed); }
+        template <typename TComponent> ComponentTicks GetComponentTicks(Entity entity) const;
+
+        // Latest tick any T component was added or accessed mutably with. It
+        // can be newer than the last actual change, never older.
+        template <typename TComponent> unsigned int GetComponentChangedTick() const {
+            return componentChangedTicks[Component<TComponent>::GetId()].load(std::memory_order_relaxed);
+        }
+
+        StorageMode GetStorageMode() const { return storageMode; }
+        const std::vector<std::unique_ptr<Archetype>> &GetArchetypes() const { return archetypes; }
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Template Implementations
+////////////////////////////////////////////////////////////////////////////////
+template <typename TComponent, typename ...TArgs>
+void Entity::AddComponent(TArgs &&...args) {
+    world->AddComponent<TComponent>(*this, std::forward<TArgs>(args)...);
+}
+
+template <typename ...TComponents>
+void Entity::AddComponents(TComponents &&...components) {
+    world->AddComponents(*this, std::forward<TComponents>(components)...);
+}
+
+template <typename TComponent>
+void Entity::RemoveComponent() {
+    world->RemoveComponent<TComponent>(*this);
+}
+
+template <typename TComponent>
+bool Entity::HasComponent() {
+    return world->HasComponent<TComponent>(*this);
+}
+
+template <typename TComponent>
+const std::remove_const_t<TComponent> &Entity::GetComponent() const {
+    return world->GetComponent<TComponent>(*this);
+}
+
+template <typename TComponent>
+TComponent &Entity::GetMutableComponent() const {
+    return world->GetMutableComponent<TComponent>(*this);
+}
+
+// System
+template <typename ...TComponents>
+void System::RequireComponent() {
+    componentSignature |= CreateSignature<TComponents...>();
+}
+
+template <typename ...TComponents>
+void System::ExcludeComponent() {
+    excludedSignature |= CreateSignature<TComponents...>();
+}
+
+template <typename ...TComponents>
+void System::OptionalComponent() {
+    ([&]() {
+        const auto componentId = Component<TComponents>::GetId();
+        if (!optionalSignature.test(componentId)) {
+            optionalSignature.set(componentId);
+            optionalPartitions.push_back(OptionalPartition());
+            optionalPartitions.back().componentId = componentId;
+        }
+    }(), ...);
+}
+
+template <typename TComponent>
+EntityRange System::GetSystemEntitiesWith() const {
+    return GetOptionalEntities(Component<TComponent>::GetId(), true);
+}
+
+template <typename TComponent>
+EntityRange System::GetSystemEntitiesWithout() const {
+    return GetOptionalEntities(Component<TComponent>::GetId(), false);
+}
+
+template <typename TFunc>
+void System::ParallelEach(JobSystem &jobSystem, TFunc func) const {
+    const auto system = GetRunningSystem();
+    jobSystem.ParallelFor(entityIds.size(), GetParallelChunkSize(sizeof(unsigned int)), [&](unsigned int begin, unsigned int end) {
+        RunAs(system, [&]() {
+            for (auto entity : EntityRange(entityIds.data() + begin, entityIds.data() + end, world)) {
+                func(entity);
+            }
+        });
+    });
+}
+
+template <typename ...TComponents>
+void System::ReadComponent() {
+    readSignature |= CreateSignature<TComponents...>();
+}
+
+template <typename ...TComponents>
+void System::WriteComponent() {
+    writeSignature |= CreateSignature<TComponents...>();
+}
+
+template <typename TFunc>
+void System::RunAs(const System *system, TFunc &&func) {
+    const auto previousSystem = runningSystem;
+    runningSystem = system;
+    func();
+    runningSystem = previousSystem;
+}
+
+// Component Info
+template <typename T>
+ComponentInfo ComponentInfo::Create() {
+    ComponentInfo info;
+    info.size = sizeof(T);
+    info.alignment = alignof(T);
+    info.moveConstruct = [](void *destination, void *source) {
+        new (destination) T(std::move(*static_cast<T *>(source)));
+    };
+    info.destroy = [](void *objects, std::size_t count) {
+        std::destroy_n(static_cast<T *>(objects), count);
+    };
+    if constexpr (std::is_copy_constructible_v<T>) {
+        info.copyConstruct = [](void *destination, const void *source, std::size_t count) {
+            std::uninitialized_copy_n(static_cast<const T *>(source), count, static_cast<T *>(destination));
+        };
+    }
+    info.isTag = IsTagComponent<T>;
+    info.isSerializable = IsSerializableComponent<T> && std::is_default_constructible_v<T>;
+    info.isReadAsBytes = !HasComponentSerializer<T> && std::is_trivially_copyable_v<T>;
+    if constexpr (std::is_default_constructible_v<T>) {
+        info.defaultConstruct = [](void *objects, std::size_t count) {
+            std::uninitialized_value_construct_n(static_cast<T *>(objects), count);
+        };
+    }
+    info.write = [](SnapshotWriter &writer, const void *objects, std::size_t count) {
+        WriteComponents(writer, static_cast<const T *>(objects), count);
+    };
+    info.read = [](SnapshotReader &reader, void *objects, std::size_t count) {
+        return ReadComponents(reader, static_cast<T *>(objects), count);
+    };
+    return info;
+}
+
+// Archetype
+template <typename T>
+T *Archetype::GetColumn(unsigned int chunk, unsigned int componentId) const {
+    const auto &column = columns[columnIndices[componentId]];
+    return reinterpret_cast<T *>(chunks[chunk] + column.offset);
+}
+
+// World
+template <typename TComponent>
+Pool<TComponent> *World::RegisterComponent() {
+    const auto componentId = Component<TComponent>::GetId();
+
+    if (componentId >= componentInfos.size()) {
+        componentInfos.resize(componentId + 1);
+    }
+    if (componentInfos[componentId].size == 0) {
+        componentInfos[componentId] = ComponentInfo::Create<TComponent>();
+    }
+
+    // Archetypes store the components themselves, and tags aren't stored
+    if (storageMode == STORAGE_ARCHETYPES || IsTagComponent<TComponent>) {
+        return nullptr;
+    }
+
+    // Resize componentPools if necessary to accomadate new component
+    if (componentId >= componentPools.size()) {
+        componentPools.resize(componentId + 1, nullptr);
+    }
+
+    // Add new component pool if necessary
+    if (!componentPools[componentId]) {
+        std::shared_ptr<Pool<TComponent>> newComponentPool = std::make_shared<Pool<TComponent>>();
+        newComponentPool->ReserveEntities(entityCapacity);
+        componentPools[componentId] = newComponentPool;
+    }
+
+    return GetComponentPool<TComponent>();
+}
+
+template <typename ...TComponents>
+void World::AddGroup() {
+    static_assert(sizeof...(TComponents) > 0, "A group needs at least one component type");
+    static_assert(!(IsTagComponent<TComponents> || ...), "Tag components have no pool to group");
+
+    // Archetypes already keep the components of an entity together
+    if (storageMode == STORAGE_ARCHETYPES) {
+        return;
+    }
+
+    (RegisterComponent<std::remove_const_t<TComponents>>(), ...);
+    CreateGroup(CreateSignature<TComponents...>());
+}
+
+template <typename ...TComponents>
+void World::Reserve(unsigned int count) {
+    if (storageMode == STORAGE_ARCHETYPES) {
+        (RegisterComponent<TComponents>(), ...);
+        archetypes[GetOrCreateArchetype(CreateSignature<TComponents...>())]->Reserve(count);
+    } else {
+        ([&]() {
+            if (auto pool = RegisterComponent<TComponents>()) {
+                pool->Reserve(count);
+            }
+        }(), ...);
+    }
+}
+
+template <typename TComponent, typename ...TArgs>
+void World::ConstructInArchetype(unsigned int entityId, bool isConstructed, TArgs &&...args) {
+    if constexpr (IsTagComponent<TComponent>) {
+        return;
+    }
+
+    auto address = GetComponentAddress(entityId, Component<TComponent>::GetId());
+    auto &ticks = GetComponentTicks(entityId, Component<TComponent>::GetId());
+    MarkComponentChanged(Component<TComponent>::GetId());
+
+    if (isConstructed) {
+        *static_cast<TComponent *>(address) = TComponent(std::forward<TArgs>(args)...);
+        ticks.changed = currentTick;
+    } else {
+        new (address) TComponent(std::forward<TArgs>(args)...);
+        ticks = {currentTick, currentTick};
+    }
+}
+
+template <typename ...TComponents>
+std::vector<Entity> World::CreateEntities(unsigned int count, const TComponents &...components) {
+    std::vector<Entity> entities;
+    entities.reserve(count);
+
+    const auto signature = CreateSignature<TComponents...>();
+    const auto pools = std::make_tuple(RegisterComponent<TComponents>()...);
+
+    if (storageMode == STORAGE_POOLS) {
+        std::apply([count](auto ...pool) { ((pool ? pool->Grow(pool->GetSize() + count) : void()), ...); }, pools);
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        const auto entity = AllocateEntity();
+        if (!IsAlive(entity)) {
+            break;
+        }
+
+        if (storageMode == STORAGE_ARCHETYPES) {
+            MoveEntityToArchetype(entity.GetId(), signature);
+            (ConstructInArchetype<TComponents>(entity.GetId(), false, components), ...);
+        } else {
+            ([&]() {
+                if constexpr (!IsTagComponent<TComponents>) {
+                    std::get<Pool<TComponents> *>(pools)->Set(entity.GetId(), components, currentTick);
+                }
+            }(), ...);
+            (UpdateEntityGroup(entity.GetId(), Component<TComponents>::GetId(), signature), ...);
+        }
+
+        // The entities are matched against the systems when they're created
+        // in the next update, so they don't need to be rematched
+        entityComponentSignatures[entity.GetIndex()] = signature;
+        entities.push_back(entity);
+    }
+
+    Logger::Log(std::to_string(entities.size()) + " entities created with " + std::to_string(sizeof...(TComponents)) + " components each");
+
+    return entities;
+}
+
+template <typename TComponent, typename ...TArgs>
+void World::AddComponent(Entity entity, TArgs &&...args) {
+    // Also covers the invalid entity returned when the entity limit is reached
+    if (!IsAlive(entity)) {
+        Logger::Error("Error: Could not add components to entity id " + std::to_string(entity.GetId()) + ", it isn't alive.");
+        return;
+    }
+
+    const auto componentId = Component<TComponent>::GetId();
+    const auto entityId = entity.GetId();
+    const auto entityIndex = entity.GetIndex();
+
+    auto componentPool = RegisterComponent<TComponent>();
+    auto &signature = entityComponentSignatures[entityIndex];
+    const bool hasComponent = signature.test(componentId);
+
+    if (storageMode == STORAGE_ARCHETYPES) {
+        if (!hasComponent) {
+            auto newSignature = signature;
+            newSignature.set(componentId);
+            MoveEntityToArchetype(entityId, newSignature);
+        }
+        ConstructInArchetype<TComponent>(entityId, hasComponent, std::forward<TArgs>(args)...);
+    } else if constexpr (!IsTagComponent<TComponent>) {
+        componentPool->Set(entityId, TComponent(std::forward<TArgs>(args)...), currentTick);
+    }
+
+    if (!hasComponent) {
+        signature.set(componentId);
+        UpdateEntityGroup(entityId, componentId, signature);
+        MarkEntityToBeRematched(entity);
+    }
+
+    Logger::Log("Component id = " + std::to_string(componentId) + " was added to entity id " + std::to_string(entityId));
+}
+
+template <typename ...TComponents>
+void World::AddComponents(Entity entity, TComponents &&...components) {
+    if (!IsAlive(entity)) {
+        Logger::Error("Error: Could not add components to entity id " + std::to_string(entity.GetId()) + ", it isn't alive.");
+        return;
+    }
+
+    const auto entityId = entity.GetId();
+    const auto entityIndex = entity.GetIndex();
+
+    (RegisterComponent<std::decay_t<TComponents>>(), ...);
+
+    auto &signature = entityComponentSignatures[entityIndex];
+    const auto oldSignature = signature;
+    const auto newSignature = oldSignature | CreateSignature<std::decay_t<TComponents>...>();
+
+    // Move the entity to its final archetype once, instead of once per component
+    if (storageMode == STORAGE_ARCHETYPES) {
+        if (newSignature != oldSignature) {
+            MoveEntityToArchetype(entityId, newSignature);
+        }
+        (ConstructInArchetype<std::decay_t<TComponents>>(entityId, oldSignature.test(Component<std::decay_t<TComponents>>::GetId()), std::forward<TComponents>(components)), ...);
+    } else {
+        ([&]() {
+            if constexpr (!IsTagComponent<std::decay_t<TComponents>>) {
+                GetComponentPool<std::decay_t<TComponents>>()->Set(entityId, std::forward<TComponents>(components), currentTick);
+            }
+        }(), ...);
+    }
+
+    if (newSignature != oldSignature) {
+        signature = newSignature;
+        (UpdateEntityGroup(entityId, Component<std::decay_t<TComponents>>::GetId(), newSignature), ...);
+        MarkEntityToBeRematched(entity);
+    }
+
+    Logger::Log(std::to_string(sizeof...(TComponents)) + " components were added to entity id " + std::to_string(entityId));
+}
+
+template <typename TComponent>
+void World::RemoveComponent(Entity entity) {
+    if (!IsAlive(entity)) {
+        return;
+    }
+
+    const auto componentId = Component<TComponent>::GetId();
+    const auto entityId = entity.GetId();
+    const auto entityIndex = entity.GetIndex();
+
+    if (!entityComponentSignatures[entityIndex].test(componentId)) {
+        return;
+    }
+
+    auto newSignature = entityComponentSignatures[entityIndex];
+    newSignature.set(componentId, false);
+
+    if (storageMode == STORAGE_ARCHETYPES) {
+        MoveEntityToArchetype(entityId, newSignature);
+    } else {
+        // Release the component data so the pool only holds live components
+        if constexpr (!IsTagComponent<TComponent>) {
+            UpdateEntityGroup(entityId, componentId, newSignature);
+            GetWritablePool(componentId)->RemoveEntityFromPool(entityId);
+        }
+    }
+
+    entityComponentSignatures[entityIndex].set(componentId, false);
+    MarkEntityToBeRematched(entity);
+
+    Logger::Log("Component id = " + std::to_string(componentId) + " was removed to entity id " + std::to_string(entityId));
+}
+
+template <typename TComponent>
+bool World::HasComponent(Entity entity) const {
+    const auto componentId = Component<TComponent>::GetId();
+    return entityComponentSignatures[entity.GetIndex()].test(componentId);
+}
+
+template <typename TComponent>
+const std::remove_const_t<TComponent> &World::GetComponent(Entity entity) const {
+    using TData = std::remove_const_t<TComponent>;
+    const auto componentId = Component<TData>::GetId();
+    const auto entityId = entity.GetId();
+
+    // Tags hold no data, any instance will do
+    if constexpr (IsTagComponent<TData>) {
+        static const TData tag{};
+        return tag;
+    } else {
+        // Reads neither stamp the ticks nor copy a pool shared with a clone,
+        // so that systems reading the same type can run concurrently
+        if (storageMode == STORAGE_ARCHETYPES) {
+            return *static_cast<const TData *>(GetComponentAddress(entityId, componentId));
+        }
+
+        return GetComponentPool<const TData>()->Get(entityId);
+    }
+}
+
+template <typename TComponent>
+TComponent &World::GetMutableComponent(Entity entity) const {
+    static_assert(!std::is_const_v<TComponent>, "Use GetComponent for read-only access");
+    const auto componentId = Component<TComponent>::GetId();
+    const auto entityId = entity.GetId();
+    CheckWriteAccess(componentId);
+
+    if constexpr (IsTagComponent<TComponent>) {
+        static TComponent tag;
+        return tag;
+    } else {
+        GetComponentTicks(entityId, componentId).changed = currentTick;
+        MarkComponentChanged(componentId);
+
+        if (storageMode == STORAGE_ARCHETYPES) {
+            return *static_cast<TComponent *>(GetComponentAddress(entityId, componentId));
+        }
+
+        return GetComponentPool<TComponent>()->Get(entityId);
+    }
+}
+
+template <typename TComponent>
+ComponentTicks World::GetComponentTicks(Entity entity) const {
+    static_assert(!IsTagComponent<TComponent>, "Tag components have no ticks");
+
+    // Reading the ticks doesn't need a pool of its own
+    if (storageMode == STORAGE_POOLS) {
+        return componentPools[Component<TComponent>::GetId()]->GetTicks(entity.GetId());
+    }
+    return GetComponentTicks(entity.GetId(), Component<TComponent>::GetId());
+}
+
+template <typename TComponent>
+Pool<std::remove_const_t<TComponent>> *World::GetComponentPool() const {
+    const auto componentId = Component<TComponent>::GetId();
+    if (componentId >= componentPools.size()) {
+        return nullptr;
+    }
+
+    // A plain pointer cast, so that hot paths don't touch the shared_ptr refcount
+    if constexpr (std::is_const_v<TComponent>) {
+        return static_cast<Pool<std::remove_const_t<TComponent>> *>(componentPools[componentId].get());
+    } else {
+        CheckWriteAccess(componentId);
+        MarkComponentChanged(componentId);
+        return static_cast<Pool<TComponent> *>(GetWritablePool(componentId));
+    }
+}
+
+template <typename TSingleton, typename ...TArgs>
+TSingleton &World::SetSingleton(TArgs &&...args) {
+    const auto singletonId = Singleton<TSingleton>::GetId();
+    if (singletonId >= singletons.size()) {
+        singletons.resize(singletonId + 1);
+    }
+
+    if (singletonId >= singletonCopies.size()) {
+        singletonCopies.resize(singletonId + 1);
+    }
+
+    auto singleton = std::make_shared<TSingleton>(std::forward<TArgs>(args)...);
+    singletons[singletonId] = singleton;
+    if constexpr (std::is_copy_constructible_v<TSingleton>) {
+        singletonCopies[singletonId] = [](const void *singleton) -> std::shared_ptr<void> {
+            return std::make_shared<TSingleton>(*static_cast<const TSingleton *>(singleton));
+        };
+    }
+    return *singleton;
+}
+
+template <typename TSingleton>
+void World::RemoveSingleton() {
+    const auto singletonId = Singleton<TSingleton>::GetId();
+    if (singletonId < singletons.size()) {
+        singletons[singletonId].reset();
+    }
+}
+
+template <typename TSingleton>
+bool World::HasSingleton() const {
+    const auto singletonId = Singleton<TSingleton>::GetId();
+    return singletonId < singletons.size() && singletons[singletonId];
+}
+
+template <typename TSingleton>
+TSingleton &World::GetSingleton() const {
+    return *static_cast<TSingleton *>(singletons[Singleton<TSingleton>::GetId()].get());
+}
+
+template <typename TComponent, typename TFunc>
+void World::OnAdd(TFunc func) {
+    AddObserver(COMPONENT_ADDED, Component<TComponent>::GetId(), std::move(func));
+}
+
+template <typename TComponent, typename TFunc>
+void World::OnRemove(TFunc func) {
+    AddObserver(COMPONENT_REMOVED, Component<TComponent>::GetId(), std::move(func));
+}
+
+template <typename TComponent, typename TFunc>
+void World::OnDestroy(TFunc func) {
+    AddObserver(COMPONENT_DESTROYED, Component<TComponent>::GetId(), std::move(func));
+}
+
+// View
+template <typename ...TComponents>
+template <typename T>
+constexpr std::size_t ComponentView<TComponents...>::IndexOf() {
+    static_assert((std::is_same_v<std::remove_const_t<T>, std::remove_const_t<TComponents>> || ...), "Filtered component type isn't viewed");
+
+    std::size_t index = 0;
+    bool isFound = false;
+    ((isFound = isFound || std::is_same_v<std::remove_const_t<T>, std::remove_const_t<TComponents>>, index += isFound ? 0 : 1), ...);
+    return index;
+}
+
+template <typename ...TComponents>
+template <typename T>
+ComponentView<TComponents...> ComponentView<TComponents...>::Changed(unsigned int tick) const {
+    auto view = *this;
+    view.changedAfter[IndexOf<T>()] = tick;
+    return view;
+}
+
+template <typename ...TComponents>
+template <typename T>
+ComponentView<TComponents...> ComponentView<TComponents...>::Added(unsigned int tick) const {
+    auto view = *this;
+    view.addedAfter[IndexOf<T>()] = tick;
+    return view;
+}
+
+template <typename ...TComponents>
+bool ComponentView<TComponents...>::HasFilters() const {
+    for (std::size_t i = 0; i < COMPONENT_COUNT; i++) {
+        if (changedAfter[i] || addedAfter[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename ...TComponents>
+bool ComponentView<TComponents...>::PassesFilters(const Ticks &ticks) const {
+    for (std::size_t i = 0; i < COMPONENT_COUNT; i++) {
+        if (ticks[i]->changed <= changedAfter[i] || ticks[i]->added <= addedAfter[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename ...TComponents>
+bool ComponentView<TComponents...>::GetPools(Pools &pools, const std::vector<unsigned int> *&entityIds) const {
+    pools = std::make_tuple(world->template GetComponentPool<TComponents>()...);
+
+    // Nothing to iterate over if any of the component types was never added
+    const bool hasAllPools = std::apply([](auto ...pool) { return ((pool != nullptr) && ...); }, pools);
+    if (!hasAllPools) {
+        return false;
+    }
+
+    // Walk the smallest pool, the other pools are only probed through their
+    // sparse vectors
+    entityIds = nullptr;
+    std::apply([&entityIds](auto ...pool) {
+        ((entityIds = (!entityIds || pool->GetEntityIds().size() < entityIds->size()) ? &pool->GetEntityIds() : entityIds), ...);
+    }, pools);
+
+    return true;
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentView<TComponents...>::Each(TFunc func) const {
+    if (world->GetStorageMode() == STORAGE_ARCHETYPES) {
+        const auto signature = CreateSignature<TComponents...>();
+
+        for (const auto &archetype : world->GetArchetypes()) {
+            if (!archetype->GetSignature().Contains(signature)) {
+                continue;
+            }
+            for (unsigned int chunk = 0; chunk < archetype->GetChunkCount(); chunk++) {
+                EachInChunk(func, *archetype, chunk);
+            }
+        }
+        return;
+    }
+
+    Pools pools;
+    const std::vector<unsigned int> *entityIds;
+    if (GetPools(pools, entityIds)) {
+        EachInPools(func, pools, entityIds->data(), entityIds->data() + entityIds->size());
+    }
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentView<TComponents...>::ParallelEach(JobSystem &jobSystem, TFunc func) const {
+    // The jobs run as the system that started the iteration
+    const auto system = System::GetRunningSystem();
+
+    if (world->GetStorageMode() == STORAGE_ARCHETYPES) {
+        const auto signature = CreateSignature<TComponents...>();
+        const auto &archetypes = world->GetArchetypes();
+
+        // Archetype chunks are already cache-sized and aligned, each job gets
+        // one of them. Chunks are numbered across the matching archetypes.
+        unsigned int chunkCount = 0;
+        for (const auto &archetype : archetypes) {
+            if (archetype->GetSignature().Contains(signature)) {
+                chunkCount += archetype->GetChunkCount();
+            }
+        }
+
+        jobSystem.ParallelFor(chunkCount, 1, [&](unsigned int begin, unsigned int end) {
+            System::RunAs(system, [&]() {
+                unsigned int firstChunk = 0;
+                for (const auto &archetype : archetypes) {
+                    if (firstChunk >= end) {
+                        break;
+                    }
+                    if (!archetype->GetSignature().Contains(signature)) {
+                        continue;
+                    }
+
+                    const auto lastChunk = firstChunk + archetype->GetChunkCount();
+                    for (auto chunk = std::max(begin, firstChunk); chunk < std::min(end, lastChunk); chunk++) {
+                        EachInChunk(func, *archetype, chunk - firstChunk);
+                    }
+                    firstChunk = lastChunk;
+                }
+            });
+        });
+        return;
+    }
+
+    Pools pools;
+    const std::vector<unsigned int> *entityIds;
+    if (!GetPools(pools, entityIds)) {
+        return;
+    }
+
+    const auto chunkSize = GetParallelChunkSize((sizeof(TComponents) + ... + sizeof(unsigned int)));
+    jobSystem.ParallelFor(entityIds->size(), chunkSize, [&](unsigned int begin, unsigned int end) {
+        System::RunAs(system, [&]() { EachInPools(func, pools, entityIds->data() + begin, entityIds->data() + end); });
+    });
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentView<TComponents...>::EachInPools(TFunc &func, const Pools &pools, const unsigned int *first, const unsigned int *last) const {
+    const bool hasFilters = HasFilters();
+    const auto tick = world->GetTick();
+    world->template MarkComponentsChanged<TComponents...>();
+
+    for (auto entityId = first; entityId != last; entityId++) {
+        const bool hasAllComponents = std::apply([entityId](auto ...pool) { return (pool->Has(*entityId) && ...); }, pools);
+        if (!hasAllComponents) {
+            continue;
+        }
+
+        if (hasFilters) {
+            const Ticks ticks = {&std::get<Pool<std::remove_const_t<TComponents>> *>(pools)->GetTicks(*entityId)...};
+            if (!PassesFilters(ticks)) {
+                continue;
+            }
+        }
+
+        // The components viewed as mutable are marked as changed
+        ([&]() {
+            if constexpr (!std::is_const_v<TComponents>) {
+                std::get<Pool<TComponents> *>(pools)->GetTicks(*entityId).changed = tick;
+            }
+        }(), ...);
+
+        if constexpr (std::is_invocable_v<TFunc &, Entity, TComponents &...>) {
+            func(Entity(*entityId, world), std::get<Pool<std::remove_const_t<TComponents>> *>(pools)->Get(*entityId)...);
+        } else {
+            func(std::get<Pool<std::remove_const_t<TComponents>> *>(pools)->Get(*entityId)...);
+        }
+    }
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentView<TComponents...>::EachInChunk(TFunc &func, const Archetype &archetype, unsigned int chunk) const {
+    const auto columns = std::make_tuple(archetype.template GetColumn<TComponents>(chunk, Component<TComponents>::GetId())...);
+    const auto entityIds = archetype.GetEntityIds(chunk);
+    const auto chunkSize = archetype.GetChunkSize(chunk);
+
+    const auto tick = world->GetTick();
+    const Ticks ticksColumns = {archetype.GetTicksColumn(chunk, Component<TComponents>::GetId())...};
+    world->template MarkComponentsChanged<TComponents...>();
+
+    const auto visit = [&](unsigned int row) {
+        if constexpr (std::is_invocable_v<TFunc &, Entity, TComponents &...>) {
+            func(Entity(entityIds[row], world), std::get<TComponents *>(columns)[row]...);
+        } else {
+            func(std::get<TComponents *>(columns)[row]...);
+        }
+    };
+
+    // Without filters every row is visited, so the mutable columns are marked
+    // as changed in one pass and the rows are streamed without any check
+    if (!HasFilters()) {
+        for (std::size_t i = 0; i < COMPONENT_COUNT; i++) {
+            if (!IS_MUTABLE[i]) {
+                continue;
+            }
+            for (unsigned int row = 0; row < chunkSize; row++) {
+                ticksColumns[i][row].changed = tick;
+            }
+        }
+        for (unsigned int row = 0; row < chunkSize; row++) {
+            visit(row);
+        }
+        return;
+    }
+
+    for (unsigned int row = 0; row < chunkSize; row++) {
+        Ticks ticks;
+        for (std::size_t i = 0; i < COMPONENT_COUNT; i++) {
+            ticks[i] = ticksColumns[i] + row;
+        }
+        if (!PassesFilters(ticks)) {
+            continue;
+        }
+        for (std::size_t i = 0; i < COMPONENT_COUNT; i++) {
+            if (IS_MUTABLE[i]) {
+                ticks[i]->changed = tick;
+            }
+        }
+
+        visit(row);
+    }
+}
+
+template <typename TSystem, typename ...TArgs>
+void World::AddSystem(TArgs &&...args) {
+    std::shared_ptr<TSystem> newSystem = std::make_shared<TSystem>(std::forward<TArgs>(args)...);
+    newSystem->world = this;
+    if constexpr (std::is_copy_constructible_v<TSystem>) {
+        newSystem->clone = [](const System &system) -> std::shared_ptr<System> {
+            return std::make_shared<TSystem>(static_cast<const TSystem &>(system));
+        };
+    }
+    systems.insert(std::make_pair(std::type_index(typeid(TSystem)), newSystem));
+    systemsBySignature.clear();
+}
+
+template <typename TSystem>
+void World::RemoveSystem() {
+    auto system = systems.find(std::type_index(typeid(TSystem)));
+    systems.erase(system);
+    systemsBySignature.clear();
 }
 
 template <typename TSystem>
@@ -302,4 +2445,122 @@ TSystem &World::GetSystem() const {
     return *(std::static_pointer_cast<TSystem>(system->second));
 }
 
+// Group
+template <typename ...TComponents>
+unsigned int ComponentGroup<TComponents...>::GetSize() const {
+    return groupIndex == World::INVALID_GROUP ? 0 : world->groups[groupIndex].size;
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentGroup<TComponents...>::Each(TFunc func) const {
+    if (groupIndex == World::INVALID_GROUP) {
+        world->View<TComponents...>().Each(func);
+        return;
+    }
+
+    const Pools pools = {world->GetComponentPool<TComponents>()...};
+    EachInRange(func, pools, 0, GetSize());
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentGroup<TComponents...>::ParallelEach(JobSystem &jobSystem, TFunc func) const {
+    if (groupIndex == World::INVALID_GROUP) {
+        world->View<TComponents...>().ParallelEach(jobSystem, func);
+        return;
+    }
+
+    const Pools pools = {world->GetComponentPool<TComponents>()...};
+    const auto chunkSize = GetParallelChunkSize((sizeof(TComponents) + ... + sizeof(unsigned int)));
+    const auto system = System::GetRunningSystem();
+    jobSystem.ParallelFor(GetSize(), chunkSize, [&](unsigned int begin, unsigned int end) {
+        System::RunAs(system, [&]() { EachInRange(func, pools, begin, end); });
+    });
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentGroup<TComponents...>::EachInRange(TFunc &func, const Pools &pools, unsigned int begin, unsigned int end) const {
+    const std::tuple<TComponents *...> columns = {std::get<Pool<std::remove_const_t<TComponents>> *>(pools)->GetDenseData()...};
+    const auto entityIds = std::get<0>(pools)->GetEntityIds().data();
+    const auto tick = world->GetTick();
+    world->template MarkComponentsChanged<TComponents...>();
+
+    // The members are visited in dense order, so the components grouped as
+    // mutable are marked as changed in one pass per pool
+    ([&]() {
+        if constexpr (!std::is_const_v<TComponents>) {
+            auto ticks = std::get<Pool<TComponents> *>(pools)->GetDenseTicks();
+            for (auto index = begin; index < end; index++) {
+                ticks[index].changed = tick;
+            }
+        }
+    }(), ...);
+
+    for (auto index = begin; index < end; index++) {
+        if constexpr (std::is_invocable_v<TFunc &, Entity, TComponents &...>) {
+            func(Entity(entityIds[index], world), std::get<TComponents *>(columns)[index]...);
+        } else {
+            func(std::get<TComponents *>(columns)[index]...);
+        }
+    }
+}
+
+// Command Buffer
+template <typename TComponent, typename ...TArgs>
+void CommandBuffer::RecordAddComponent(unsigned int sortKey, unsigned int entityId, bool isDeferred, TArgs &&...args) {
+    auto component = new (Allocate(sizeof(TComponent), alignof(TComponent))) TComponent(std::forward<TArgs>(args)...);
+
+    Command command;
+    command.type = COMMAND_ADD_COMPONENT;
+    command.sortKey = sortKey;
+    command.entityId = entityId;
+    command.isDeferred = isDeferred;
+    command.component = component;
+    command.play = [](class World &world, Entity entity, void *component) {
+        world.AddComponent<TComponent>(entity, std::move(*static_cast<TComponent *>(component)));
+    };
+    command.destroy = [](void *component) {
+        static_cast<TComponent *>(component)->~TComponent();
+    };
+    commands.push_back(command);
+}
+
+template <typename TComponent, typename ...TArgs>
+void CommandBuffer::AddComponent(unsigned int sortKey, Entity entity, TArgs &&...args) {
+    RecordAddComponent<TComponent>(sortKey, entity.GetId(), false, std::forward<TArgs>(args)...);
+}
+
+template <typename TComponent, typename ...TArgs>
+void CommandBuffer::AddComponent(DeferredEntity entity, TArgs &&...args) {
+    RecordAddComponent<TComponent>(entity.sortKey, entity.index, true, std::forward<TArgs>(args)...);
+}
+
+template <typename TComponent>
+void CommandBuffer::RemoveComponent(unsigned int sortKey, Entity entity) {
+    Command command;
+    command.type = COMMAND_REMOVE_COMPONENT;
+    command.sortKey = sortKey;
+    command.entityId = entity.GetId();
+    command.isDeferred = false;
+    command.component = nullptr;
+    command.play = [](class World &world, Entity entity, void *) {
+        world.RemoveComponent<TComponent>(entity);
+    };
+    command.destroy = nullptr;
+    commands.push_back(command);
+}
+
+template <typename TSystem, typename TFunc>
+void World::ScheduleSystem(TFunc func) {
+    auto system = systems.find(std::type_index(typeid(TSystem)));
+    if (system == systems.end()) {
+        Logger::Error("Error: Could not schedule a system that wasn't added to the world.");
+        return;
+    }
+
+    scheduledSystems.push_back({system->second.get(), [func](System &system) mutable { func(static_cast<TSystem &>(system)); }, 0, 0, 0});
+}
+
 #endif
\ No newline at end of file
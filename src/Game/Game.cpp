@@ -19,6 +19,7 @@ Game::Game() {
     world = std::make_unique<World>();
     assetStore = std::make_unique<AssetStore>();
     eventBus = std::make_unique<EventBus>();
+    jobSystem = std::make_unique<JobSystem>();
 
     Logger::Log("Game constructor called.");
 }
@@ -100,6 +101,12 @@ void Game::ProcessInput() {
                 if (event.key.keysym.sym == SDLK_d) {
                     isDebug = !isDebug;
                 }
+                if (event.key.keysym.sym == SDLK_F5) {
+                    world->SaveSnapshot(quicksave);
+                }
+                if (event.key.keysym.sym == SDLK_F9 && !quicksave.empty()) {
+                    world->RestoreSnapshot(quicksave);
+                }
                 break; 
         }
     }
@@ -108,6 +115,7 @@ void Game::ProcessInput() {
 void Game::LoadLevel(int level) {
     // Add the systems need to be by our game
     world->AddSystem<MovementSystem>();
+    world->AddSystem<TransformSystem>();
     world->AddSystem<RenderSystem>();
     world->AddSystem<AnimationSystem>();
     world->AddSystem<CollisionSystem>();
@@ -115,6 +123,9 @@ void Game::LoadLevel(int level) {
     world->AddSystem<DamageSystem>();
     world->AddSystem<KeyboardMovementSystem>();
 
+    // Keep the transforms and rigid bodies moved every frame packed side by side
+    world->AddGroup<TransformComponent, RigidBodyComponent>();
+
     // Adding asets to the asset store
     assetStore->AddTexture(renderer, "tank-image", "./assets/images/tank-panther-right.png");
     assetStore->AddTexture(renderer, "truck-image", "./assets/images/truck-ford-right.png");
@@ -139,6 +150,13 @@ void Game::LoadLevel(int level) {
     }
 
     // Read the level layout
+    struct Tile {
+        glm::vec2 position;
+        int srcRectX;
+        int srcRectY;
+    };
+    std::vector<Tile> tiles;
+
     std::string line;
     int y = 0;
     while (std::getline(mapFile, line)) {
@@ -150,9 +168,7 @@ void Game::LoadLevel(int level) {
             int srcRectY = (value[0] - '0') * tileSize;
             int srcRectX = (value[1] - '0') * tileSize;
 
-            Entity tile  = world->CreateEntity();
-            tile.AddComponent<TransformComponent>(glm::vec2(x * (tileSize * tileScale), y * (tileSize * tileScale)), glm::vec2(tileScale, tileScale));
-            tile.AddComponent<SpriteComponent>("tilemap-image", tileSize, tileSize, 0, srcRectX, srcRectY);
+            tiles.push_back({glm::vec2(x * (tileSize * tileScale), y * (tileSize * tileScale)), srcRectX, srcRectY});
 
             x += 1;
         }
@@ -160,6 +176,21 @@ void Game::LoadLevel(int level) {
     }
     mapFile.close();
 
+    // Create all the tiles in one batch, then place each of them
+    auto tileEntities = world->CreateEntities(
+        tiles.size(),
+        TransformComponent(glm::vec2(0, 0), glm::vec2(tileScale, tileScale)),
+        SpriteComponent("tilemap-image", tileSize, tileSize, 0)
+    );
+
+    for (std::size_t i = 0; i < tileEntities.size(); i++) {
+        tileEntities[i].GetMutableComponent<TransformComponent>().position = tiles[i].position;
+
+        auto &sprite = tileEntities[i].GetMutableComponent<SpriteComponent>();
+        sprite.srcRect.x = tiles[i].srcRectX;
+        sprite.srcRect.y = tiles[i].srcRectY;
+    }
+
     Entity chopper = world->CreateEntity();
     chopper.AddComponent<TransformComponent>(
         glm::vec2(10.0, 10.0),
@@ -237,10 +268,15 @@ void Game::Update() {
     // Update the world to process the entities that are to be created/destroyed
     world->Update();
 
-    // Invoke all the systems that need to update
-    world->GetSystem<MovementSystem>().Update(deltaTime);
-    world->GetSystem<AnimationSystem>().Update();
-    world->GetSystem<CollisionSystem>().Update(eventBus);
+    // Invoke all the systems that need to update. The systems that don't
+    // touch the same components run in parallel, so MovementSystem and
+    // AnimationSystem run together, TransformSystem places the children once
+    // their parents moved, and CollisionSystem waits for both.
+    world->ScheduleSystem<MovementSystem>([this, deltaTime](MovementSystem &system) { system.Update(*jobSystem, deltaTime); });
+    world->ScheduleSystem<TransformSystem>([](TransformSystem &system) { system.Update(); });
+    world->ScheduleSystem<AnimationSystem>([this](AnimationSystem &system) { system.Update(*jobSystem); });
+    world->ScheduleSystem<CollisionSystem>([this](CollisionSystem &system) { system.Update(eventBus); });
+    world->RunScheduledSystems(*jobSystem);
 
 }
 
@@ -4,6 +4,7 @@
 #include "../ECS/ECS.h"
 #include "../AssetStore/AssetStore.h"
 #include "../Events/EventBus.h"
+#include "../Jobs/JobSystem.h"
 
 #include <SDL2/SDL.h>
 
@@ -23,6 +24,10 @@ class Game {
         std::unique_ptr<World> world;
         std::unique_ptr<AssetStore> assetStore;
         std::unique_ptr<EventBus> eventBus;
+        std::unique_ptr<JobSystem> jobSystem;
+
+        // Last quicksave, restored with F9
+        std::vector<unsigned char> quicksave;
 
     public:
         Game();
@@ -0,0 +1,169 @@
+#include "JobSystem.h"
+
+#include "../Logger/Logger.h"
+
+// Index of the queue owned by the current thread, 0 for the non-worker threads
+static thread_local unsigned int currentQueueIndex = 0;
+
+JobSystem::JobSystem(unsigned int workerCount) {
+    for (unsigned int i = 0; i < workerCount + 1; i++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (unsigned int i = 1; i < workerCount + 1; i++) {
+        workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+
+    Logger::Log("JobSystem created with " + std::to_string(workerCount) + " workers");
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isRunning = false;
+    }
+    wakeCondition.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    Logger::Log("JobSystem destroyed");
+}
+
+void JobSystem::Push(Job job) {
+    auto &queue = *queues[currentQueueIndex];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+        queuedJobCount.fetch_add(1, std::memory_order_release);
+    }
+
+    // Taking the sleep mutex makes sure a worker about to sleep sees the job
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeCondition.notify_one();
+}
+
+bool JobSystem::TryPop(unsigned int queueIndex, Job &job) {
+    auto &queue = *queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) {
+        return false;
+    }
+
+    job = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool JobSystem::TrySteal(unsigned int queueIndex, Job &job) {
+    for (unsigned int i = 1; i < queues.size(); i++) {
+        auto &queue = *queues[(queueIndex + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::Execute(Job &job) {
+    job.function();
+
+    if (!job.counter) {
+        return;
+    }
+
+    // Decrement under the lock, so that a dependency can't be added between
+    // the counter dropping to zero and the dependent jobs being taken, and so
+    // that Wait doesn't return while the counter is still being touched
+    std::vector<std::function<void()>> continuations;
+    {
+        std::lock_guard<std::mutex> lock(job.counter->continuationsMutex);
+        if (job.counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            continuations.swap(job.counter->continuations);
+        }
+    }
+
+    // The counter dropped to zero, schedule the jobs that depended on it
+    for (auto &continuation : continuations) {
+        continuation();
+    }
+}
+
+void JobSystem::WorkerLoop(unsigned int queueIndex) {
+    currentQueueIndex = queueIndex;
+
+    while (true) {
+        Job job;
+        if (TryPop(queueIndex, job) || TrySteal(queueIndex, job)) {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeCondition.wait(lock, [this]() { return !isRunning || queuedJobCount.load(std::memory_order_acquire) > 0; });
+        if (!isRunning) {
+            return;
+        }
+    }
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter *counter) {
+    if (counter) {
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+    }
+    Push({std::move(function), counter});
+}
+
+void JobSystem::RunAfter(JobCounter &dependency, std::function<void()> function, JobCounter *counter) {
+    if (counter) {
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The job is pushed by whichever thread finishes the last dependency, the
+    // counter being already incremented above
+    auto continuation = [this, function = std::move(function), counter]() mutable {
+        Push({std::move(function), counter});
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(dependency.continuationsMutex);
+        if (!dependency.IsDone()) {
+            dependency.continuations.push_back(std::move(continuation));
+            return;
+        }
+    }
+    continuation();
+}
+
+unsigned int JobSystem::GetCurrentThreadIndex() {
+    return currentQueueIndex;
+}
+
+bool JobSystem::RunPendingJob() {
+    Job job;
+    if (TryPop(currentQueueIndex, job) || TrySteal(currentQueueIndex, job)) {
+        Execute(job);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::Wait(JobCounter &counter) {
+    while (!counter.IsDone()) {
+        if (!RunPendingJob()) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Let the thread that finished the last job release the counter
+    std::lock_guard<std::mutex> lock(counter.continuationsMutex);
+}
@@ -0,0 +1,136 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+////////////////////////////////////////////////////////////////////////////////
+// Job Counter
+////////////////////////////////////////////////////////////////////////////////
+// Counts the jobs of a batch that haven't finished yet. Jobs can be made to
+// depend on a counter, they are scheduled once it drops to zero.
+////////////////////////////////////////////////////////////////////////////////
+class JobCounter {
+    private:
+        std::atomic<unsigned int> count {0};
+
+        // Jobs waiting for the counter to drop to zero
+        std::mutex continuationsMutex;
+        std::vector<std::function<void()>> continuations;
+
+        friend class JobSystem;
+
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter &) = delete;
+        JobCounter &operator =(const JobCounter &) = delete;
+
+        // A counter must be waited on with JobSystem::Wait before it is destroyed
+        bool IsDone() const { return count.load(std::memory_order_acquire) == 0; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Job System
+////////////////////////////////////////////////////////////////////////////////
+// A pool of worker threads running small jobs. Every worker owns a deque: it
+// pushes and pops its own jobs at the back, while idle workers steal from the
+// front of the others. The thread that owns the job system has a deque too,
+// and runs jobs instead of blocking when it waits on a counter.
+// Example: jobSystem->ParallelFor(count, 256, [](unsigned int begin, unsigned int end) {...});
+////////////////////////////////////////////////////////////////////////////////
+class JobSystem {
+    private:
+        struct Job {
+            std::function<void()> function;
+            JobCounter *counter;
+        };
+
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        // Queue 0 belongs to the threads that aren't workers
+        // [Vector index = worker index]
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        std::vector<std::thread> workers;
+
+        // Number of jobs sitting in the queues, idle workers sleep while it's zero
+        std::atomic<unsigned int> queuedJobCount {0};
+        std::atomic<bool> isRunning {true};
+        std::mutex sleepMutex;
+        std::condition_variable wakeCondition;
+
+        void Push(Job job);
+        bool TryPop(unsigned int queueIndex, Job &job);
+        bool TrySteal(unsigned int queueIndex, Job &job);
+        void Execute(Job &job);
+        void WorkerLoop(unsigned int queueIndex);
+
+    public:
+        // By default one worker per core, the calling thread taking the last core
+        JobSystem(unsigned int workerCount = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        ~JobSystem();
+
+        JobSystem(const JobSystem &) = delete;
+        JobSystem &operator =(const JobSystem &) = delete;
+
+        // Number of threads running jobs, including the waiting thread
+        unsigned int GetThreadCount() const { return workers.size() + 1; }
+
+        // Index of the calling thread, from 1 to the worker count for the
+        // workers and 0 for any other thread
+        static unsigned int GetCurrentThreadIndex();
+
+        // Queues a job, the counter (if any) is incremented until it finishes
+        void Run(std::function<void()> function, JobCounter *counter = nullptr);
+
+        // Queues a job once all the jobs counted by dependency have finished
+        void RunAfter(JobCounter &dependency, std::function<void()> function, JobCounter *counter = nullptr);
+
+        // Runs one queued job on the calling thread, returns false if there was none
+        bool RunPendingJob();
+
+        // Runs queued jobs on the calling thread until the counter drops to zero
+        void Wait(JobCounter &counter);
+
+        // Splits [0, count) into chunks of chunkSize elements, runs
+        // func(begin, end) on each of them in parallel, and waits for them
+        template <typename TFunc> void ParallelFor(unsigned int count, unsigned int chunkSize, TFunc func);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Template Implementations
+////////////////////////////////////////////////////////////////////////////////
+template <typename TFunc>
+void JobSystem::ParallelFor(unsigned int count, unsigned int chunkSize, TFunc func) {
+    chunkSize = std::max(chunkSize, 1u);
+    if (count <= chunkSize || workers.empty()) {
+        if (count > 0) {
+            func(0u, count);
+        }
+        return;
+    }
+
+    // The last chunk runs on the calling thread, before it starts helping
+    JobCounter counter;
+    unsigned int begin = 0;
+    for (; begin + chunkSize < count; begin += chunkSize) {
+        const auto end = begin + chunkSize;
+        Run([&func, begin, end]() { func(begin, end); }, &counter);
+    }
+    func(begin, count);
+
+    Wait(counter);
+}
+
+#endif
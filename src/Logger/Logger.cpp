@@ -4,9 +4,13 @@
 #include <string>
 #include <chrono>
 #include <ctime>
+#include <mutex>
 
 std::vector<LogEntry> Logger::entries;
 
+// Jobs can log from any thread, the entries and the output are shared
+static std::mutex logMutex;
+
 std::string CurrentDateTimeToString() {
     const auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
     std::string output(30, '\0');
@@ -15,6 +19,8 @@ std::string CurrentDateTimeToString() {
 }
 
 void Logger::Log(const std::string &message) {
+    std::lock_guard<std::mutex> lock(logMutex);
+
     LogEntry entry;
     entry.type = LOG_INFO;
     entry.message = "LOG: [" + CurrentDateTimeToString() + "]: " + message;
@@ -23,6 +29,8 @@ void Logger::Log(const std::string &message) {
 }
 
 void Logger::Error(const std::string &message) {
+    std::lock_guard<std::mutex> lock(logMutex);
+
     LogEntry entry;
     entry.type = LOG_ERROR;
     entry.message = "ERROR: [" + CurrentDateTimeToString() + "]: " + message;
@@ -31,6 +39,8 @@ void Logger::Error(const std::string &message) {
 }
 
 void Logger::Warn(const std::string &message) {
+    std::lock_guard<std::mutex> lock(logMutex);
+
     LogEntry entry;
     entry.type = LOG_WARNING;
     entry.message = "WARN: [" + CurrentDateTimeToString() + "]: " + message;
@@ -10,55 +10,201 @@
 
 #include <string>
 #include <algorithm>
+#include <cmath>
 #include <SDL2/SDL.h>
 
 class MovementSystem : public System {
     public:
         MovementSystem() {
-            RequireComponent<TransformComponent>();
-            RequireComponent<RigidBodyComponent>();
+            RequireComponent<TransformComponent, RigidBodyComponent>();
+            ReadComponent<RigidBodyComponent>();
+            WriteComponent<TransformComponent>();
         }
 
-        void Update(double deltaTime) {
-            // TODO:
-            // Loop all entities that the system is interested in 
-            for (auto entity : GetSystemEntities()) {
-                // TODO:
-                // Update entity position based on its velocity every frame of the game loop.
-                auto &transform = entity.GetComponent<TransformComponent>();
-                const auto &rigidbody = entity.GetComponent<RigidBodyComponent>();
-
+        void Update(JobSystem &jobSystem, double deltaTime) {
+            // Update entity position based on its velocity every frame of the game loop.
+            // Every body is independent, so the bodies are split across the workers.
+            world->Group<TransformComponent, const RigidBodyComponent>().ParallelEach(jobSystem, [deltaTime](TransformComponent &transform, const RigidBodyComponent &rigidbody) {
                 transform.position.x += rigidbody.velocity.x * deltaTime;
                 transform.position.y += rigidbody.velocity.y * deltaTime;
-                Logger::Log(
-                    "Entity id = " +
-                    std::to_string(entity.GetId()) +
-                    " position is now (" +
-                    std::to_string(transform.position.x) +
-                    ", " +
-                    std::to_string(transform.position.y) + ")"
+            });
+        }
+};
+
+class TransformSystem : public System {
+    private:
+        // Entities of the system sorted by depth, so that parents are always
+        // updated before their children
+        std::vector<unsigned int> order;
+
+        // Parent each entity had and its depth when the order was built
+        // [Vector index = entity index]
+        std::vector<unsigned int> parentIds;
+        std::vector<unsigned int> depths;
+
+        // Membership version of the system when the order was built
+        unsigned int orderVersion = 0;
+
+        unsigned int lastTick = 0;
+
+        bool IsOrderValid(unsigned int sinceTick) {
+            if (orderVersion != GetMembershipVersion()) {
+                return false;
+            }
+
+            // Only the hierarchies that changed can have a new parent
+            if (world->GetComponentChangedTick<HierarchyComponent>() <= sinceTick) {
+                return true;
+            }
+            bool isValid = true;
+            world->View<const HierarchyComponent>().Changed<HierarchyComponent>(sinceTick).Each([this, &isValid](Entity entity, const HierarchyComponent &hierarchy) {
+                if (HasEntity(entity) && parentIds[entity.GetIndex()] != hierarchy.parent.GetId()) {
+                    isValid = false;
+                }
+            });
+            return isValid;
+        }
+
+        void SortOrder() {
+            order = GetSystemEntityIds();
+            orderVersion = GetMembershipVersion();
+            for (auto entityId : order) {
+                const Entity entity(entityId, world);
+                if (entity.GetIndex() >= parentIds.size()) {
+                    parentIds.resize(entity.GetIndex() + 1);
+                    depths.resize(entity.GetIndex() + 1);
+                }
+                parentIds[entity.GetIndex()] = entity.GetComponent<const HierarchyComponent>().parent.GetId();
+            }
+
+            // The depth counts the ancestors that are in the system too
+            for (auto entityId : order) {
+                unsigned int depth = 0;
+                Entity ancestor(parentIds[GetEntityIndex(entityId)]);
+                while (HasEntity(ancestor) && depth <= order.size()) {
+                    ancestor = Entity(parentIds[ancestor.GetIndex()]);
+                    depth++;
+                }
+                if (depth > order.size()) {
+                    Logger::Error("Entity id " + std::to_string(entityId) + " is part of a hierarchy cycle");
+                }
+                depths[GetEntityIndex(entityId)] = depth;
+            }
+
+            std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) {
+                return depths[GetEntityIndex(a)] < depths[GetEntityIndex(b)];
+            });
+        }
+
+    public:
+        TransformSystem() {
+            RequireComponent<TransformComponent>();
+            RequireComponent<HierarchyComponent>();
+            ReadComponent<HierarchyComponent>();
+            WriteComponent<TransformComponent>();
+        }
+
+        void Update() {
+            // Nothing to recompute when no entity joined or left the system,
+            // and no hierarchy or transform changed since the last pass
+            const auto sinceTick = lastTick;
+            const bool hasChanges =
+                orderVersion != GetMembershipVersion() ||
+                world->GetComponentChangedTick<HierarchyComponent>() > sinceTick ||
+                world->GetComponentChangedTick<TransformComponent>() > sinceTick;
+            if (!hasChanges) {
+                return;
+            }
+
+            if (!IsOrderValid(sinceTick)) {
+                SortOrder();
+            }
+
+            // An entity is recomputed when its local transform or its parent's
+            // transform changed. Recomputing marks its own transform as changed,
+            // which carries the update down to its children further in the order.
+            for (auto entityId : order) {
+                const Entity entity(entityId, world);
+                const auto &hierarchy = entity.GetComponent<const HierarchyComponent>();
+                const auto &parent = hierarchy.parent;
+                if (!world->IsAlive(parent) || !world->HasComponent<TransformComponent>(parent)) {
+                    continue;
+                }
+
+                const bool isDirty =
+                    world->GetComponentTicks<HierarchyComponent>(entity).changed > sinceTick ||
+                    world->GetComponentTicks<TransformComponent>(parent).changed > sinceTick;
+                if (!isDirty) {
+                    continue;
+                }
+
+                const auto &parentTransform = world->GetComponent<const TransformComponent>(parent);
+                auto &transform = entity.GetMutableComponent<TransformComponent>();
+
+                const auto angle = glm::radians(parentTransform.rotation);
+                const auto offset = hierarchy.localPosition * parentTransform.scale;
+                transform.position = parentTransform.position + glm::vec2(
+                    offset.x * std::cos(angle) - offset.y * std::sin(angle),
+                    offset.x * std::sin(angle) + offset.y * std::cos(angle)
                 );
-            }    
+                transform.scale = parentTransform.scale * hierarchy.localScale;
+                transform.rotation = parentTransform.rotation + hierarchy.localRotation;
+            }
+
+            // Advanced after the pass, so the transforms written above aren't
+            // seen as changed again next time
+            lastTick = world->AdvanceTick();
         }
 };
 
 class RenderSystem : public System {
+    private:
+        struct Renderable {
+            const TransformComponent *transform;
+            const SpriteComponent *sprite;
+        };
+
+        // Reused every frame to avoid reallocating the sort buffer
+        std::vector<Renderable> renderables;
+
+        // Draw order of the renderables, kept from the previous frame since
+        // it rarely changes. The renderables are gathered in the same order
+        // every frame as long as no component is added or removed.
+        std::vector<unsigned int> drawOrder;
+
     public:
         RenderSystem() {
             RequireComponent<TransformComponent>();
             RequireComponent<SpriteComponent>();
+            ReadComponent<TransformComponent, SpriteComponent>();
         }
 
         void Update(SDL_Renderer *renderer, std::unique_ptr<AssetStore> &assetStore) {
-            // Sort all the entities of our system by z-index
-            auto entities = GetSystemEntities();
-            std::sort(entities.begin(), entities.end(), [](const Entity &a, const Entity &b) {
-                return a.GetComponent<SpriteComponent>().zIndex < b.GetComponent<SpriteComponent>().zIndex;
+            // Gather the renderables once, so sorting doesn't look components up
+            renderables.clear();
+            world->View<const TransformComponent, const SpriteComponent>().Each([this](const TransformComponent &transform, const SpriteComponent &sprite) {
+                renderables.push_back({&transform, &sprite});
             });
 
-            for (auto entity : entities) {
-                const auto transform = entity.GetComponent<TransformComponent>();
-                const auto sprite = entity.GetComponent<SpriteComponent>();
+            // Sort all the entities of our system by z-index, only when the
+            // previous order doesn't hold anymore
+            const auto isDrawnBefore = [this](unsigned int a, unsigned int b) {
+                return renderables[a].sprite->zIndex < renderables[b].sprite->zIndex;
+            };
+            if (drawOrder.size() != renderables.size()) {
+                drawOrder.resize(renderables.size());
+                for (unsigned int i = 0; i < drawOrder.size(); i++) {
+                    drawOrder[i] = i;
+                }
+                std::sort(drawOrder.begin(), drawOrder.end(), isDrawnBefore);
+            } else if (!std::is_sorted(drawOrder.begin(), drawOrder.end(), isDrawnBefore)) {
+                std::sort(drawOrder.begin(), drawOrder.end(), isDrawnBefore);
+            }
+
+            for (const auto index : drawOrder) {
+                const auto &renderable = renderables[index];
+                const auto &transform = *renderable.transform;
+                const auto &sprite = *renderable.sprite;
 
                 auto texture = assetStore->GetTexture(sprite.assetId);
 
@@ -89,62 +235,66 @@ class AnimationSystem : public System {
         AnimationSystem() {
             RequireComponent<SpriteComponent>();
             RequireComponent<AnimationComponent>();
+            WriteComponent<SpriteComponent, AnimationComponent>();
         }
 
-        void Update() {
-            for (auto entity : GetSystemEntities()) {
-                auto &animation = entity.GetComponent<AnimationComponent>();
-                auto &sprite = entity.GetComponent<SpriteComponent>();
+        void Update(JobSystem &jobSystem) {
+            const auto ticks = SDL_GetTicks();
 
+            world->View<SpriteComponent, AnimationComponent>().ParallelEach(jobSystem, [ticks](SpriteComponent &sprite, AnimationComponent &animation) {
                 animation.currentFrame = (
-                    (SDL_GetTicks() - animation.startTime) * animation.frameSpeedRate / 1000
+                    (ticks - animation.startTime) * animation.frameSpeedRate / 1000
                 ) % animation.numFrames;
 
                 sprite.srcRect.x = animation.currentFrame * sprite.width;
-            }
+            });
         }
 };
 
 class CollisionSystem : public System {
+    private:
+        struct Collider {
+            Entity entity;
+            double x, y, width, height;
+        };
+
+        // Reused every frame to avoid reallocating the collider buffer
+        std::vector<Collider> colliders;
+
     public:
         CollisionSystem() {
             RequireComponent<TransformComponent>();
             RequireComponent<BoxColliderComponent>();
+            ReadComponent<TransformComponent, BoxColliderComponent>();
         }
 
         void Update(std::unique_ptr<EventBus> &eventBus) {
-            struct Box {
-                int left, right, top, bottom;
-            };
-
-            const auto entities = GetSystemEntities();
-
-            for (auto i=entities.begin(); i!=entities.end(); i++) {
-                auto a = *i;
-
-                const auto aTransform = a.GetComponent<TransformComponent>();
-                const auto aCollider = a.GetComponent<BoxColliderComponent>();
+            // Compute the world-space box of every collider once
+            colliders.clear();
+            world->View<const TransformComponent, const BoxColliderComponent>().Each([this](Entity entity, const TransformComponent &transform, const BoxColliderComponent &collider) {
+                colliders.push_back({
+                    entity,
+                    transform.position.x + collider.offset.x * transform.scale.x,
+                    transform.position.y + collider.offset.y * transform.scale.y,
+                    collider.width * transform.scale.x,
+                    collider.height * transform.scale.y
+                });
+            });
 
-                for (auto j=std::next(i); j!=entities.end(); j++) {
-                    auto b = *j;
+            for (auto i=colliders.begin(); i!=colliders.end(); i++) {
+                const auto &a = *i;
 
-                    const auto bTransform = b.GetComponent<TransformComponent>();
-                    const auto bCollider = b.GetComponent<BoxColliderComponent>();
+                for (auto j=std::next(i); j!=colliders.end(); j++) {
+                    const auto &b = *j;
 
                     bool collisionHappened = checkkAABBCollision(
-                        aTransform.position.x + aCollider.offset.x * aTransform.scale.x,
-                        aTransform.position.y + aCollider.offset.y * aTransform.scale.y,
-                        aCollider.width * aTransform.scale.x,
-                        aCollider.height * aTransform.scale.y,
-                        bTransform.position.x + bCollider.offset.x * bTransform.scale.x,
-                        bTransform.position.y + bCollider.offset.y * bTransform.scale.y,
-                        bCollider.width * bTransform.scale.x,
-                        bCollider.height * bTransform.scale.y
+                        a.x, a.y, a.width, a.height,
+                        b.x, b.y, b.width, b.height
                     );
 
                     if (collisionHappened) {
-                        eventBus->EmitEvent<CollisionEvent>(a, b);
-                        Logger::Log("Entity " + std::to_string(a.GetId()) + " is colliding with " + std::to_string(b.GetId()));
+                        eventBus->EmitEvent<CollisionEvent>(a.entity, b.entity);
+                        Logger::Log("Entity " + std::to_string(a.entity.GetId()) + " is colliding with " + std::to_string(b.entity.GetId()));
                     }
                 }
             } 
@@ -156,26 +306,44 @@ class CollisionSystem : public System {
 };
 
 class RenderCollisionSystem : public System {
+    private:
+        // Screen rect of each collider, only recomputed when its transform or
+        // its box changed
+        // [Vector index = entity index]
+        std::vector<SDL_Rect> rects;
+        unsigned int lastTick = 0;
+
     public:
         RenderCollisionSystem() {
             RequireComponent<TransformComponent>();
             RequireComponent<BoxColliderComponent>();
+            ReadComponent<TransformComponent, BoxColliderComponent>();
         }
 
         void Update(SDL_Renderer *renderer) {
-            for (auto entity : GetSystemEntities()) {
-                const auto transform = entity.GetComponent<TransformComponent>();
-                const auto collider = entity.GetComponent<BoxColliderComponent>();
+            const auto updateRect = [this](Entity entity, const TransformComponent &transform, const BoxColliderComponent &collider) {
+                if (entity.GetIndex() >= rects.size()) {
+                    rects.resize(entity.GetIndex() + 1);
+                }
 
-                SDL_Rect rect = {
+                rects[entity.GetIndex()] = {
                     static_cast<int>(transform.position.x + collider.offset.x * transform.scale.x),
                     static_cast<int>(transform.position.y + collider.offset.y * transform.scale.y),
                     static_cast<int>(collider.width * transform.scale.x),
                     static_cast<int>(collider.height * transform.scale.y)
                 };
+            };
+
+            const auto sinceTick = lastTick;
+            lastTick = world->AdvanceTick();
+
+            auto colliders = world->View<const TransformComponent, const BoxColliderComponent>();
+            colliders.Changed<TransformComponent>(sinceTick).Each(updateRect);
+            colliders.Changed<BoxColliderComponent>(sinceTick).Each(updateRect);
 
-                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-                SDL_RenderDrawRect(renderer, &rect);
+            SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+            for (auto entityId : GetSystemEntityIds()) {
+                SDL_RenderDrawRect(renderer, &rects[GetEntityIndex(entityId)]);
             }
         }
 };
@@ -188,8 +356,11 @@ class DamageSystem : public System {
 
         void onCollision(CollisionEvent &event) {
             Logger::Log("The DamageSystem recieved a collision event between entities " + std::to_string(event.a.GetId()) + " & " + std::to_string(event.b.GetId()));
-            event.a.Destroy();
-            event.b.Destroy();
+            // Collisions are detected inside a job, so the destruction is
+            // recorded and played back by the next world update
+            auto &commandBuffer = world->GetCommandBuffer();
+            commandBuffer.DestroyEntity(event.a.GetIndex(), event.a);
+            commandBuffer.DestroyEntity(event.a.GetIndex(), event.b);
         }
 
         void SubscribeToEvents(std::unique_ptr<EventBus> &eventBus) {
@@ -0,0 +1,68 @@
+#include "Test.h"
+
+namespace {
+    struct TestHealth {
+        int value = 100;
+    };
+
+    struct TestArmor {
+        int value = 0;
+    };
+
+    class HealthSystem: public System {
+        public:
+            HealthSystem() {
+                RequireComponent<TestHealth>();
+            }
+    };
+}
+
+TEST(ComponentChangedTickFollowsWrites) {
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        World world(storageMode);
+        auto entity = world.CreateEntity();
+        entity.AddComponent<TestHealth>();
+        entity.AddComponent<TestArmor>();
+        world.Update();
+
+        const auto sinceTick = world.AdvanceTick();
+        CHECK(world.GetComponentChangedTick<TestHealth>() <= sinceTick);
+
+        // Reads leave the type unchanged, writes through any path mark it
+        CHECK(entity.GetComponent<TestHealth>().value == 100);
+        world.View<const TestHealth>().Each([](const TestHealth &) {});
+        CHECK(world.GetComponentChangedTick<TestHealth>() <= sinceTick);
+
+        entity.GetMutableComponent<TestHealth>().value = 50;
+        CHECK(world.GetComponentChangedTick<TestHealth>() > sinceTick);
+        CHECK(world.GetComponentChangedTick<TestArmor>() <= sinceTick);
+
+        world.View<TestArmor>().Each([](TestArmor &armor) { armor.value++; });
+        CHECK(world.GetComponentChangedTick<TestArmor>() > sinceTick);
+
+        // A clone starts with the same marks
+        const auto clone = world.Clone();
+        CHECK(clone->GetComponentChangedTick<TestHealth>() == world.GetComponentChangedTick<TestHealth>());
+    }
+}
+
+TEST(MembershipVersionFollowsSystemEntities) {
+    World world;
+    world.AddSystem<HealthSystem>();
+    const auto &system = world.GetSystem<HealthSystem>();
+
+    auto entity = world.CreateEntity();
+    entity.AddComponent<TestHealth>();
+    world.Update();
+    const auto version = system.GetMembershipVersion();
+
+    // Unrelated changes keep the version
+    entity.AddComponent<TestArmor>();
+    entity.GetMutableComponent<TestHealth>().value = 10;
+    world.Update();
+    CHECK(system.GetMembershipVersion() == version);
+
+    entity.RemoveComponent<TestHealth>();
+    world.Update();
+    CHECK(system.GetMembershipVersion() != version);
+}
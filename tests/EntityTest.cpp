@@ -0,0 +1,45 @@
+#include "Test.h"
+
+namespace {
+    struct TestBullet {
+        int damage = 1;
+    };
+}
+
+TEST(StaleEntitiesStayDeadAfterGenerationsRunOut) {
+    World world;
+    const auto firstEntity = world.CreateEntity();
+    world.Update();
+
+    // A slot reused every frame goes through all of its generations
+    auto entity = firstEntity;
+    bool isFirstIndexReused = true;
+    for (unsigned int i = 0; i <= ENTITY_GENERATION_MASK + 10; i++) {
+        world.DestroyEntity(entity);
+        world.Update();
+        entity = world.CreateEntity();
+        world.Update();
+
+        CHECK(!world.IsAlive(firstEntity));
+        isFirstIndexReused = isFirstIndexReused && entity.GetIndex() == firstEntity.GetIndex();
+    }
+
+    // The slot is retired instead of wrapping back to the first generation
+    CHECK(!isFirstIndexReused);
+    CHECK(world.IsAlive(entity));
+}
+
+TEST(ComponentsArentAddedToInvalidEntities) {
+    World world;
+    world.CreateEntities(MAX_ENTITIES);
+    world.Update();
+
+    // Past the entity limit, the invalid entity is ignored
+    auto entity = world.CreateEntity();
+    CHECK(!world.IsAlive(entity));
+    entity.AddComponent<TestBullet>();
+    entity.AddComponents(TestBullet());
+    entity.RemoveComponent<TestBullet>();
+    world.Update();
+    CHECK(!world.IsAlive(entity));
+}
@@ -0,0 +1,163 @@
+#include "Test.h"
+#include "../src/Jobs/JobSystem.h"
+
+#include <atomic>
+
+namespace {
+    struct TestPosition {
+        int x = 0;
+    };
+
+    struct TestVelocity {
+        int x = 1;
+    };
+
+    class PositionReaderSystem: public System {
+        public:
+            std::atomic<int> sum {0};
+
+            PositionReaderSystem() {
+                RequireComponent<TestPosition>();
+                ReadComponent<TestPosition>();
+            }
+
+            PositionReaderSystem(const PositionReaderSystem &other): System(other) {}
+
+            void Update(JobSystem &jobSystem) {
+                for (auto entity : GetSystemEntities()) {
+                    sum += entity.GetComponent<TestPosition>().x;
+                }
+                world->View<const TestPosition>().ParallelEach(jobSystem, [this](const TestPosition &position) {
+                    sum += position.x;
+                });
+            }
+    };
+
+    class OtherPositionReaderSystem: public PositionReaderSystem {};
+
+    class MovementTestSystem: public System {
+        public:
+            MovementTestSystem() {
+                RequireComponent<TestPosition, TestVelocity>();
+                ReadComponent<TestVelocity>();
+                WriteComponent<TestPosition>();
+            }
+
+            void Update(JobSystem &jobSystem) {
+                ParallelEach(jobSystem, [](Entity entity) {
+                    entity.GetMutableComponent<TestPosition>().x += entity.GetComponent<TestVelocity>().x;
+                });
+            }
+    };
+
+    std::vector<Entity> CreatePositions(World &world, unsigned int count) {
+        std::vector<Entity> entities;
+        for (unsigned int i = 0; i < count; i++) {
+            auto entity = world.CreateEntity();
+            entity.AddComponent<TestPosition>(TestPosition{static_cast<int>(i)});
+            entity.AddComponent<TestVelocity>();
+            entities.push_back(entity);
+        }
+        world.Update();
+        return entities;
+    }
+}
+
+TEST(ReadOnlySystemsShareComponentsWithoutWriting) {
+    JobSystem jobSystem(3);
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        World world(storageMode);
+        world.AddSystem<PositionReaderSystem>();
+        world.AddSystem<OtherPositionReaderSystem>();
+        const auto entities = CreatePositions(world, 10000);
+        CHECK(!world.GetSystem<PositionReaderSystem>().ConflictsWith(world.GetSystem<OtherPositionReaderSystem>()));
+
+        const auto clone = world.Clone();
+        const auto addedTick = world.GetComponentTicks<TestPosition>(entities[0]).changed;
+        world.AdvanceTick();
+
+        world.ScheduleSystem<PositionReaderSystem>([&jobSystem](PositionReaderSystem &system) { system.Update(jobSystem); });
+        world.ScheduleSystem<OtherPositionReaderSystem>([&jobSystem](OtherPositionReaderSystem &system) { system.Update(jobSystem); });
+        world.RunScheduledSystems(jobSystem);
+
+        // Both systems saw every component twice, and the reads left the
+        // ticks and the pool shared with the clone alone
+        const int expectedSum = 2 * (10000 * 9999 / 2);
+        CHECK(world.GetSystem<PositionReaderSystem>().sum == expectedSum);
+        CHECK(world.GetSystem<OtherPositionReaderSystem>().sum == expectedSum);
+        for (auto entity : entities) {
+            CHECK(world.GetComponentTicks<TestPosition>(entity).changed == addedTick);
+        }
+        if (storageMode == STORAGE_POOLS) {
+            CHECK(world.GetComponentPool<const TestPosition>() == clone->GetComponentPool<const TestPosition>());
+        }
+    }
+}
+
+TEST(GetMutableComponentMarksChanges) {
+    JobSystem jobSystem(3);
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        World world(storageMode);
+        world.AddSystem<MovementTestSystem>();
+        const auto entities = CreatePositions(world, 1000);
+
+        const auto clone = world.Clone();
+        world.AdvanceTick();
+        const auto tick = world.GetTick();
+
+        world.ScheduleSystem<MovementTestSystem>([&jobSystem](MovementTestSystem &system) { system.Update(jobSystem); });
+        world.RunScheduledSystems(jobSystem);
+
+        for (unsigned int i = 0; i < entities.size(); i++) {
+            CHECK(world.GetComponent<TestPosition>(entities[i]).x == static_cast<int>(i) + 1);
+            CHECK(world.GetComponentTicks<TestPosition>(entities[i]).changed == tick);
+            CHECK(world.GetComponentTicks<TestVelocity>(entities[i]).changed != tick);
+        }
+
+        // The clone kept its own copy of the written components
+        Entity clonedEntity(entities[1].GetId(), clone.get());
+        CHECK(clonedEntity.GetComponent<TestPosition>().x == 1);
+    }
+}
+
+TEST(ScheduledSystemsRunOncePerFrame) {
+    JobSystem jobSystem(3);
+    World world;
+    world.AddSystem<MovementTestSystem>();
+    world.AddSystem<PositionReaderSystem>();
+
+    // The reader waits for the writer, which can finish before the scheduler
+    // is done starting the systems that wait for nothing
+    for (unsigned int frame = 0; frame < 1000; frame++) {
+        std::atomic<int> writerRunCount {0};
+        std::atomic<int> readerRunCount {0};
+        world.ScheduleSystem<MovementTestSystem>([&writerRunCount](MovementTestSystem &) { writerRunCount++; });
+        world.ScheduleSystem<PositionReaderSystem>([&readerRunCount](PositionReaderSystem &) { readerRunCount++; });
+        world.RunScheduledSystems(jobSystem);
+
+        CHECK(writerRunCount == 1);
+        CHECK(readerRunCount == 1);
+    }
+}
+
+TEST(OptionalComponentsCountAsReads) {
+    class OptionalPositionSystem: public System {
+        public:
+            OptionalPositionSystem() {
+                RequireComponent<TestVelocity>();
+                OptionalComponent<TestPosition>();
+                ReadComponent<TestVelocity>();
+            }
+    };
+
+    // Optional terms don't filter the entities, only the scheduling
+    World world;
+    world.AddSystem<OptionalPositionSystem>();
+    const auto entities = CreatePositions(world, 10);
+    world.RemoveComponent<TestPosition>(entities[0]);
+    world.Update();
+
+    CHECK(world.GetSystem<OptionalPositionSystem>().GetSystemEntityIds().size() == 10);
+    CHECK(OptionalPositionSystem().ConflictsWith(MovementTestSystem()));
+    CHECK(!OptionalPositionSystem().ConflictsWith(PositionReaderSystem()));
+}
@@ -0,0 +1,170 @@
+#include "Test.h"
+
+#include <cstring>
+
+namespace {
+    struct TestScore {
+        int value = 0;
+    };
+
+    struct TestLives {
+        int value = 3;
+    };
+
+    struct TestCopyCounter {
+        inline static unsigned int copyCount = 0;
+
+        int value = 0;
+
+        TestCopyCounter() = default;
+        TestCopyCounter(const TestCopyCounter &other) : value(other.value) { copyCount++; }
+        TestCopyCounter &operator =(const TestCopyCounter &other) { value = other.value; copyCount++; return *this; }
+    };
+}
+
+template <>
+struct ComponentSerializer<TestCopyCounter> {
+    static void Write(SnapshotWriter &writer, const TestCopyCounter &counter) { writer.Write(counter.value); }
+    static bool Read(SnapshotReader &reader, TestCopyCounter &counter) { return reader.Read(counter.value); }
+};
+
+namespace {
+    class ScoreSystem: public System {
+        public:
+            ScoreSystem() {
+                RequireComponent<TestScore>();
+            }
+    };
+
+    // Saves a world with two entities, which get the given components
+    template <typename ...AComponents, typename ...BComponents>
+    std::vector<unsigned char> SaveTwoEntities(StorageMode storageMode, std::tuple<AComponents...>, std::tuple<BComponents...>) {
+        World world(storageMode);
+        [[maybe_unused]] auto a = world.CreateEntity();
+        [[maybe_unused]] auto b = world.CreateEntity();
+        (a.AddComponent<AComponents>(), ...);
+        (b.AddComponent<BComponents>(), ...);
+        world.Update();
+
+        std::vector<unsigned char> buffer;
+        world.SaveSnapshot(buffer);
+        return buffer;
+    }
+
+    // The entity part of one snapshot followed by the component part of
+    // another, both saved from two entities
+    std::vector<unsigned char> SpliceSnapshots(StorageMode storageMode, const std::vector<unsigned char> &entities, const std::vector<unsigned char> &components) {
+        // Without components, only the count of component types follows the
+        // entities
+        const auto entitiesSize = SaveTwoEntities(storageMode, std::tuple<>(), std::tuple<>()).size() - sizeof(unsigned int);
+
+        std::vector<unsigned char> buffer(entities.begin(), entities.begin() + entitiesSize);
+        buffer.insert(buffer.end(), components.begin() + entitiesSize, components.end());
+        return buffer;
+    }
+
+    // Overwrites an unsigned int of a snapshot, offsets are in unsigned ints
+    std::vector<unsigned char> PatchSnapshot(std::vector<unsigned char> buffer, unsigned int offset, unsigned int value) {
+        std::memcpy(buffer.data() + offset * sizeof(unsigned int), &value, sizeof(unsigned int));
+        return buffer;
+    }
+
+    // Offsets in a snapshot, after the magic, version, signature size and tick
+    const unsigned int NEXT_FREE_INDEX_OFFSET = 4;
+    const unsigned int ENTITY_IDS_OFFSET = 6;
+}
+
+TEST(RestoreRejectsComponentsNotMatchingSignatures) {
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        const auto scoreAndLives = SaveTwoEntities(storageMode, std::tuple<TestScore>(), std::tuple<TestLives>());
+        const auto livesAndScore = SaveTwoEntities(storageMode, std::tuple<TestLives>(), std::tuple<TestScore>());
+        const auto bothAndScore = SaveTwoEntities(storageMode, std::tuple<TestScore, TestLives>(), std::tuple<TestScore>());
+        const auto scoreAndScore = SaveTwoEntities(storageMode, std::tuple<TestScore>(), std::tuple<TestScore>());
+
+        World world(storageMode);
+        world.AddSystem<ScoreSystem>();
+        // Restoring needs the component types to be registered already
+        world.CreateEntity().AddComponents(TestScore(), TestLives());
+        world.Update();
+        CHECK(world.RestoreSnapshot(SpliceSnapshots(storageMode, scoreAndLives, scoreAndLives)));
+        CHECK(world.GetSystem<ScoreSystem>().GetSystemEntities().GetSize() == 1);
+
+        // Components stored for entities whose signatures lack them
+        CHECK(!world.RestoreSnapshot(SpliceSnapshots(storageMode, scoreAndLives, livesAndScore)));
+        CHECK(world.GetSystem<ScoreSystem>().GetSystemEntities().GetSize() == 0);
+
+        // Signatures having components that aren't stored
+        CHECK(!world.RestoreSnapshot(SpliceSnapshots(storageMode, bothAndScore, scoreAndScore)));
+        CHECK(world.GetSystem<ScoreSystem>().GetSystemEntities().GetSize() == 0);
+
+        // The rejected snapshots leave an empty world that still works
+        auto entity = world.CreateEntity();
+        entity.AddComponent<TestScore>();
+        world.Update();
+        CHECK(world.GetSystem<ScoreSystem>().GetSystemEntities().GetSize() == 1);
+        CHECK(!entity.HasComponent<TestLives>());
+    }
+}
+
+TEST(RestoreKeepsPoolsSharedWithClones) {
+    World world;
+    for (int value = 0; value < 10; value++) {
+        TestCopyCounter counter;
+        counter.value = value;
+        world.CreateEntity().AddComponent<TestCopyCounter>(counter);
+    }
+    world.Update();
+    std::vector<unsigned char> buffer;
+    CHECK(world.SaveSnapshot(buffer));
+
+    // Clearing the world for the restore leaves the shared pool to the clone
+    // instead of copying it
+    const auto clone = world.Clone();
+    TestCopyCounter::copyCount = 0;
+    CHECK(world.RestoreSnapshot(buffer));
+    CHECK(TestCopyCounter::copyCount == 0);
+
+    int cloneSum = 0;
+    clone->View<const TestCopyCounter>().Each([&](const TestCopyCounter &counter) { cloneSum += counter.value; });
+    CHECK(cloneSum == 45);
+}
+
+TEST(RestoreRejectsCorruptedFreeLists) {
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        World world(storageMode);
+        std::vector<Entity> entities;
+        for (int i = 0; i < 4; i++) {
+            entities.push_back(world.CreateEntity());
+        }
+        world.Update();
+
+        // Slots 2 then 1 are freed, the list goes 1, 2, end
+        world.DestroyEntity(entities[2]);
+        world.DestroyEntity(entities[1]);
+        world.Update();
+        std::vector<unsigned char> buffer;
+        CHECK(world.SaveSnapshot(buffer));
+
+        const std::vector<std::vector<unsigned char>> corruptedBuffers = {
+            // Head on a live slot or past the slots
+            PatchSnapshot(buffer, NEXT_FREE_INDEX_OFFSET, 0),
+            PatchSnapshot(buffer, NEXT_FREE_INDEX_OFFSET, 4),
+            // Link past the slots
+            PatchSnapshot(buffer, ENTITY_IDS_OFFSET + 1, CreateEntityId(7, 1)),
+            // Link on a live slot
+            PatchSnapshot(buffer, ENTITY_IDS_OFFSET + 2, CreateEntityId(3, 1)),
+            // Cycle between the free slots
+            PatchSnapshot(buffer, ENTITY_IDS_OFFSET + 2, CreateEntityId(1, 1)),
+        };
+        for (const auto &corruptedBuffer : corruptedBuffers) {
+            CHECK(!world.RestoreSnapshot(corruptedBuffer));
+            CHECK(world.CreateEntity().GetIndex() == 0);
+        }
+
+        // The valid list recycles the free slots before adding new ones
+        CHECK(world.RestoreSnapshot(buffer));
+        CHECK(world.CreateEntity().GetIndex() == 1);
+        CHECK(world.CreateEntity().GetIndex() == 2);
+        CHECK(world.CreateEntity().GetIndex() == 4);
+    }
+}
@@ -0,0 +1,81 @@
+#include "Test.h"
+
+namespace {
+    struct TestSprite {
+        int layer = 0;
+    };
+
+    struct TestAnimation {
+        int frame = 0;
+    };
+
+    class SpriteTestSystem: public System {
+        public:
+            SpriteTestSystem() {
+                RequireComponent<TestSprite>();
+                OptionalComponent<TestAnimation>();
+            }
+
+            SpriteTestSystem(const SpriteTestSystem &other): System(other) {}
+    };
+
+    // Whether the system's entities are split on the animation as the world
+    // says they should be
+    bool IsSplitOnAnimation(const World &world, const SpriteTestSystem &system, std::size_t withCount, std::size_t withoutCount) {
+        bool isSplit = system.GetSystemEntitiesWith<TestAnimation>().GetSize() == withCount;
+        isSplit = isSplit && system.GetSystemEntitiesWithout<TestAnimation>().GetSize() == withoutCount;
+        for (auto entity : system.GetSystemEntitiesWith<TestAnimation>()) {
+            isSplit = isSplit && system.HasEntity(entity) && world.HasComponent<TestAnimation>(entity);
+        }
+        for (auto entity : system.GetSystemEntitiesWithout<TestAnimation>()) {
+            isSplit = isSplit && system.HasEntity(entity) && !world.HasComponent<TestAnimation>(entity);
+        }
+        return isSplit;
+    }
+}
+
+TEST(OptionalComponentsSplitSystemEntities) {
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        World world(storageMode);
+        world.AddSystem<SpriteTestSystem>();
+        const auto &system = world.GetSystem<SpriteTestSystem>();
+
+        std::vector<Entity> entities;
+        for (int i = 0; i < 6; i++) {
+            entities.push_back(world.CreateEntity());
+            entities.back().AddComponent<TestSprite>();
+            if (i % 2 == 0) {
+                entities.back().AddComponent<TestAnimation>();
+            }
+        }
+        world.Update();
+        CHECK(system.GetSystemEntities().GetSize() == 6);
+        CHECK(IsSplitOnAnimation(world, system, 3, 3));
+
+        // Gaining and losing the optional component moves the entity across
+        entities[1].AddComponent<TestAnimation>();
+        entities[0].RemoveComponent<TestAnimation>();
+        entities[2].RemoveComponent<TestAnimation>();
+        world.Update();
+        CHECK(IsSplitOnAnimation(world, system, 2, 4));
+
+        // Leaving the system removes the entity from both sides
+        entities[1].RemoveComponent<TestSprite>();
+        world.DestroyEntity(entities[3]);
+        world.DestroyEntity(entities[4]);
+        world.Update();
+        CHECK(system.GetSystemEntities().GetSize() == 3);
+        CHECK(IsSplitOnAnimation(world, system, 0, 3));
+
+        // Snapshots and clones keep the split
+        entities[5].AddComponent<TestAnimation>();
+        world.Update();
+        std::vector<unsigned char> buffer;
+        CHECK(world.SaveSnapshot(buffer));
+        CHECK(world.RestoreSnapshot(buffer));
+        CHECK(IsSplitOnAnimation(world, system, 1, 2));
+
+        const auto clone = world.Clone();
+        CHECK(IsSplitOnAnimation(*clone, clone->GetSystem<SpriteTestSystem>(), 1, 2));
+    }
+}
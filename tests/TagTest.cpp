@@ -0,0 +1,31 @@
+#include "Test.h"
+
+namespace {
+    struct TestEnemyTag {};
+
+    struct TestPlayerTag {};
+
+    struct TestScore {
+        int value = 0;
+    };
+}
+
+TEST(AddComponentsTakesTagLvalues) {
+    for (auto storageMode : {STORAGE_POOLS, STORAGE_ARCHETYPES}) {
+        World world(storageMode);
+        auto entity = world.CreateEntity();
+
+        // Forwarded lvalues are deduced as references, which must still be
+        // recognized as tags
+        TestEnemyTag enemyTag;
+        const TestPlayerTag playerTag;
+        TestScore score {7};
+        entity.AddComponents(enemyTag, playerTag, score);
+        world.AddComponents(entity, enemyTag, TestScore{8});
+        world.Update();
+
+        CHECK(entity.HasComponent<TestEnemyTag>());
+        CHECK(entity.HasComponent<TestPlayerTag>());
+        CHECK(entity.GetComponent<TestScore>().value == 8);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include "../src/ECS/ECS.h"
+#include "../src/Logger/Logger.h"
+
+#include <cstdio>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Test Helpers
+////////////////////////////////////////////////////////////////////////////////
+// Shared by the tests in tests/, built and run by `make test`. Like the
+// benchmarks, the tests only link the engine sources that don't need SDL.
+// TEST(Name) { ... } registers a test, CHECK(condition) reports a failed
+// condition and carries on with the test.
+////////////////////////////////////////////////////////////////////////////////
+struct TestCase {
+    const char *name;
+    void (*func)();
+};
+
+inline std::vector<TestCase> &GetTestCases() {
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+inline unsigned int failedCheckCount = 0;
+
+inline bool RegisterTest(const char *name, void (*func)()) {
+    GetTestCases().push_back({name, func});
+    return true;
+}
+
+inline void ReportFailedCheck(const char *file, int line, const char *condition) {
+    std::printf("    %s:%d: CHECK(%s) failed\n", file, line, condition);
+    failedCheckCount++;
+}
+
+#define TEST(name) \
+    static void name(); \
+    static const bool name##IsRegistered = RegisterTest(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            ReportFailedCheck(__FILE__, __LINE__, #condition); \
+        } \
+    } while (false)
+
+#endif
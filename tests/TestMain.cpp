@@ -0,0 +1,24 @@
+#include "Test.h"
+
+#include <iostream>
+
+int main() {
+    // Keep the log out of the test report
+    std::cout.rdbuf(nullptr);
+
+    unsigned int failedTestCount = 0;
+    for (const auto &testCase : GetTestCases()) {
+        const auto previousFailedCheckCount = failedCheckCount;
+        testCase.func();
+        Logger::entries.clear();
+
+        const bool hasPassed = failedCheckCount == previousFailedCheckCount;
+        std::printf("%s %s\n", hasPassed ? "[PASS]" : "[FAIL]", testCase.name);
+        if (!hasPassed) {
+            failedTestCount++;
+        }
+    }
+
+    std::printf("%zu tests, %u failed\n", GetTestCases().size(), failedTestCount);
+    return failedTestCount == 0 ? 0 : 1;
+}